@@ -2,10 +2,20 @@
 #include <string>
 #include <random>
 #include <chrono>
+#include <filesystem>
+#include <numeric>
+#include <algorithm>
+#include <utility>
+#include <tuple>
 #include <cassert>
+#include <cstdint>
+#include <memory>
 
 import cbtsp;
 import config;
+import construction;
+import local;
+import mco;
 import setup;
 import statistics;
 import util;
@@ -19,19 +29,41 @@ void runFromConfiguration(const Configuration& configuration)
     }
 
     // random number setup
-    const auto seed = std::chrono::system_clock::now().time_since_epoch().count();
+    const auto clockSeed = std::chrono::system_clock::now().time_since_epoch().count();
+    const std::uint64_t seed = configuration.seed.value_or(static_cast<std::uint64_t>(clockSeed));
     auto random = std::make_shared<Random>(static_cast<Random::result_type>(seed));
 
     const auto searchBuilder = SearchBuilder(configuration.algorithm,
-        configuration.stepFunction,
+        configuration.stepFunction, configuration.tourLayout, configuration.dontLookBits, configuration.deltaStore,
         configuration.iterations, configuration.popsize,
         configuration.evaporation, configuration.elitism,
         configuration.minPheromone, configuration.maxPheromone,
         configuration.pheromoneAttraction, configuration.objectiveAttraction,
-        configuration.intensification, configuration.reinforceStrategy,
-        random);
+        configuration.intensification, configuration.reinforceStrategy, configuration.candidates,
+        configuration.searchThreads, random);
 
-    const auto search = searchBuilder.buildSearch();
+    const auto buildSearch = [&searchBuilder](const std::shared_ptr<Random>& stream)
+    {
+        return searchBuilder.buildSearch(stream);
+    };
+
+    std::cout << format("Random seed: {}\n", seed);
+
+    if (configuration.batch) {
+        const auto complete = [&configuration](const std::filesystem::path& inputFile, const Statistics& statistics)
+        {
+            auto solutionFile = inputFile;
+            solutionFile.replace_filename(statistics.name() + ".solution");
+            writeResults(statistics, solutionFile, configuration.statsOutfile);
+            std::cout << "Recorded results for " << statistics.name() << ".\n";
+        };
+
+        std::cout << format("Running {} searches on {} problems as one batch:\n",
+            configuration.runs, configuration.inputFiles.size());
+        measureBatch(configuration.inputFiles, buildSearch, configuration.runs, configuration.threads, seed, complete);
+        std::cout << "All done.\n";
+        return;
+    }
 
     for (const auto inputFile : configuration.inputFiles) {
         std::cout << "Loading problem: " << inputFile.filename() << " - ";
@@ -40,7 +72,8 @@ void runFromConfiguration(const Configuration& configuration)
 
         const auto name = inputFile.stem().string();
         std::cout << format("Running {} searches on " + name + " - ", configuration.runs);
-        const auto statistics = Statistics::measure(name, *search, problem, configuration.runs);
+        const auto statistics = Statistics::measure(name, buildSearch, problem,
+            configuration.runs, configuration.threads, seed);
         std::cout << "done.\n";
 
         auto solutionFile = inputFile;
@@ -126,12 +159,322 @@ void runPopsizeMco(Configuration& configuration)
     }
 }
 
+// Run the loader benchmark, which parses every input file repeatedly and reports the throughput.
+void runBenchLoad(const Configuration& configuration)
+{
+    using fracSecs = std::chrono::duration<double>;
+
+    for (const auto& inputFile : configuration.inputFiles) {
+        const auto megabytes = std::filesystem::file_size(inputFile) / 1e6;
+        std::size_t vertices = 0;
+
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < configuration.runs; i++) {
+            const auto problem = readProblemFile(inputFile);
+            vertices = problem.vertices();
+        }
+        const auto stop = std::chrono::steady_clock::now();
+
+        const auto seconds = std::chrono::duration_cast<fracSecs>(stop - start).count() / configuration.runs;
+        std::cout << inputFile.filename() << " (" << vertices << " vertices): "
+            << seconds * 1e3 << " ms per load, " << megabytes / seconds << " MB/s\n";
+    }
+}
+
+// Apply random two-edge exchange moves, then random evaluations, to a tour in the given layout.
+// Returns the final vertex sequence, the seconds spent on moves and evaluations, and a checksum.
+auto benchTourLayout(const Problem& problem, TourLayout layout, int moves)
+{
+    using fracSecs = std::chrono::duration<double>;
+
+    auto vertices = std::vector<Vertex>(problem.vertices());
+    std::iota(vertices.begin(), vertices.end(), Vertex{ 0 });
+    auto solution = Solution(problem, std::move(vertices));
+    solution.setLayout(layout);
+
+    auto random = Random(1);
+    auto distribution = std::uniform_int_distribution<std::size_t>(0, problem.vertices() - 1);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < moves; i++)
+        solution.twoOpt(distribution(random), distribution(random));
+    const auto middle = std::chrono::steady_clock::now();
+    Value checksum = 0;
+    for (int i = 0; i < moves; i++)
+        checksum += solution.twoOptValue(distribution(random), distribution(random));
+    const auto stop = std::chrono::steady_clock::now();
+
+    const auto moveSeconds = std::chrono::duration_cast<fracSecs>(middle - start).count();
+    const auto evalSeconds = std::chrono::duration_cast<fracSecs>(stop - middle).count();
+    solution.setLayout(TourLayout::ARRAY);
+    return std::tuple(solution.vertices(), moveSeconds, evalSeconds, checksum);
+}
+
+// Run the tour benchmark, which compares the array and two-level layouts on the same random moves.
+void runBenchTour(const Configuration& configuration)
+{
+    const int moves = configuration.iterations;
+
+    for (const auto& inputFile : configuration.inputFiles) {
+        const auto problem = readProblemFile(inputFile);
+        const auto [arrayTour, arrayMove, arrayEval, arraySum] = benchTourLayout(problem, TourLayout::ARRAY, moves);
+        const auto [twoLevelTour, twoLevelMove, twoLevelEval, twoLevelSum] = benchTourLayout(problem, TourLayout::TWO_LEVEL, moves);
+
+        if (arrayTour != twoLevelTour || arraySum != twoLevelSum)
+            throw std::runtime_error("Tour layouts disagree on " + inputFile.string() + ".");
+
+        std::cout << inputFile.filename() << " (" << problem.vertices() << " vertices): "
+            << "array " << arrayMove / moves * 1e6 << " us/move, "
+            << "two-level " << twoLevelMove / moves * 1e6 << " us/move, "
+            << "speedup " << arrayMove / twoLevelMove << "x; "
+            << "evaluations " << moves / arrayEval / 1e6 << " vs " << moves / twoLevelEval / 1e6 << " M/s\n";
+    }
+}
+
+// Apply best-improvement steps to a random tour and return the result with the elapsed seconds.
+// The step function modifies the given solution to its best neighbor.
+template<typename StepFunction>
+auto benchStep(const Problem& problem, StepFunction step, int steps)
+{
+    using fracSecs = std::chrono::duration<double>;
+
+    auto vertices = std::vector<Vertex>(problem.vertices());
+    std::iota(vertices.begin(), vertices.end(), Vertex{ 0 });
+    std::shuffle(vertices.begin(), vertices.end(), Random(1));
+    auto solution = Solution(problem, std::move(vertices));
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < steps; i++)
+        step(solution);
+    const auto stop = std::chrono::steady_clock::now();
+
+    return std::pair(solution.vertices(), std::chrono::duration_cast<fracSecs>(stop - start).count());
+}
+
+// Run the step benchmark, which compares the virtual and the statically dispatched best-improvement steps,
+// as well as the neighbor-by-neighbor, the row-wise and the cached best-improvement scans.
+// With multiple search threads, it also measures the row-wise scan split among the threads of a pool.
+void runBenchStep(const Configuration& configuration)
+{
+    const int steps = configuration.iterations;
+    const int threads = workerThreads(configuration.searchThreads);
+    auto pool = threads > 1 ? std::make_unique<ThreadPool>(threads) : nullptr;
+
+    for (const auto& inputFile : configuration.inputFiles) {
+        const auto problem = readProblemFile(inputFile);
+        auto dynamicStep = BestImprovement(std::make_unique<TwoExchangeNeighborhood>());
+        auto staticStep = BasicBestImprovement<TwoExchangeNeighborhood>(std::make_unique<TwoExchangeNeighborhood>());
+        const auto [dynamicTour, dynamicSeconds] = benchStep(problem,
+            [&dynamicStep](Solution& solution) { dynamicStep.step(solution); }, steps);
+        const auto [staticTour, staticSeconds] = benchStep(problem,
+            [&staticStep](Solution& solution) { staticStep.step(solution); }, steps);
+
+        if (dynamicTour != staticTour)
+            throw std::runtime_error("Step functions disagree on " + inputFile.string() + ".");
+
+        auto neighborhood = TwoExchangeNeighborhood();
+        const auto iteratorStep = [&neighborhood](Solution& solution)
+        {
+            neighborhood.Neighborhood::bestMove(solution, solution.objective()).apply(solution);
+        };
+        const auto rowStep = [&neighborhood](Solution& solution)
+        {
+            neighborhood.bestMove(solution, solution.objective()).apply(solution);
+        };
+        const auto [iteratorTour, iteratorSeconds] = benchStep(problem, iteratorStep, steps);
+        const auto [rowTour, rowSeconds] = benchStep(problem, rowStep, steps);
+
+        if (iteratorTour != rowTour || iteratorTour != staticTour)
+            throw std::runtime_error("Scans disagree on " + inputFile.string() + ".");
+
+        neighborhood.reset(problem.vertices());
+        const double evaluations = static_cast<double>(neighborhood.size()) * steps;
+
+        std::cout << inputFile.filename() << " (" << problem.vertices() << " vertices): "
+            << "virtual " << evaluations / dynamicSeconds / 1e6 << " M evals/s, "
+            << "static " << evaluations / staticSeconds / 1e6 << " M evals/s, "
+            << "speedup " << dynamicSeconds / staticSeconds << "x; "
+            << "iterator " << evaluations / iteratorSeconds / 1e6 << " M evals/s, "
+            << "rows " << evaluations / rowSeconds / 1e6 << " M evals/s, "
+            << "speedup " << iteratorSeconds / rowSeconds << "x";
+
+        // the delta cache takes quadratic memory, so only measure it where steps would use it
+        if (problem.vertices() <= DeltaCache::maxVertices) {
+            auto cache = DeltaCache();
+            const auto cachedStep = [&neighborhood, &cache](Solution& solution)
+            {
+                const Move move = neighborhood.bestMove(solution, solution.objective(), cache);
+                cache.expect(move);
+                move.apply(solution);
+            };
+            const auto [cachedTour, cachedSeconds] = benchStep(problem, cachedStep, steps);
+
+            if (iteratorTour != cachedTour)
+                throw std::runtime_error("Scans disagree on " + inputFile.string() + ".");
+
+            std::cout << "; cached " << evaluations / cachedSeconds / 1e6 << " M evals/s";
+        }
+
+        // below the threshold, the parallel scan is the serial one
+        if (pool) {
+            const auto parallelStep = [&neighborhood, &pool](Solution& solution)
+            {
+                neighborhood.bestMove(solution, solution.objective(), *pool).apply(solution);
+            };
+            const auto [parallelTour, parallelSeconds] = benchStep(problem, parallelStep, steps);
+
+            if (iteratorTour != parallelTour)
+                throw std::runtime_error("Scans disagree on " + inputFile.string() + ".");
+
+            std::cout << "; " << threads << " threads " << evaluations / parallelSeconds / 1e6 << " M evals/s";
+        }
+
+        std::cout << "\n";
+    }
+}
+
+// Run the descent benchmark, which compares full local search with and without don't-look bits,
+// and with the delta index where the instance is small enough for it.
+void runBenchDescent(const Configuration& configuration)
+{
+    using fracSecs = std::chrono::duration<double>;
+
+    for (const auto& inputFile : configuration.inputFiles) {
+        const auto problem = readProblemFile(inputFile);
+        auto vertices = std::vector<Vertex>(problem.vertices());
+        std::iota(vertices.begin(), vertices.end(), Vertex{ 0 });
+        std::shuffle(vertices.begin(), vertices.end(), Random(1));
+        const auto start = Solution(problem, std::move(vertices));
+
+        std::cout << inputFile.filename() << " (" << problem.vertices() << " vertices), start " << start.objective();
+
+        const auto measure = [&start](std::unique_ptr<Step> step)
+        {
+            auto search = LocalSearch(move(step));
+
+            const auto begin = std::chrono::steady_clock::now();
+            const auto result = search.search(start);
+            const auto end = std::chrono::steady_clock::now();
+
+            std::cout << std::chrono::duration_cast<fracSecs>(end - begin).count() * 1e3 << " ms to "
+                << result.objective();
+        };
+
+        std::cout << ": best-improvement ";
+        measure(std::make_unique<BasicBestImprovement<TwoExchangeNeighborhood>>(std::make_unique<TwoExchangeNeighborhood>()));
+        std::cout << "; don't-look ";
+        measure(std::make_unique<DontLookImprovement>(std::make_unique<TwoExchangeNeighborhood>()));
+
+        if (problem.vertices() <= DeltaIndex::maxVertices) {
+            std::cout << "; delta index ";
+            measure(std::make_unique<BasicBestImprovement<TwoExchangeNeighborhood>>(
+                std::make_unique<TwoExchangeNeighborhood>(), DeltaStore::INDEX));
+        }
+
+        std::cout << "\n";
+    }
+}
+
+// Run the construction benchmark, which times the random, the deterministic and the balanced construction heuristics.
+void runBenchConstruction(const Configuration& configuration)
+{
+    using fracSecs = std::chrono::duration<double>;
+
+    for (const auto& inputFile : configuration.inputFiles) {
+        const auto problem = readProblemFile(inputFile);
+
+        std::cout << inputFile.filename() << " (" << problem.vertices() << " vertices)";
+
+        const auto measure = [&problem](Construction& construction)
+        {
+            const auto begin = std::chrono::steady_clock::now();
+            const auto result = construction.construct(problem);
+            const auto end = std::chrono::steady_clock::now();
+
+            std::cout << std::chrono::duration_cast<fracSecs>(end - begin).count() * 1e3 << " ms to "
+                << result.objective();
+        };
+
+        auto randomConstruction = RandomConstruction(RandomSelector(std::make_shared<Random>(1)), BestTourInserter());
+        auto deterministicConstruction = DeterministicConstruction(FarthestCitySelector(), BestTourInserter());
+        auto balancedConstruction = BalancedConstruction(BalancedSelector(), BestTourInserter());
+
+        std::cout << ": random ";
+        measure(randomConstruction);
+        std::cout << "; deterministic ";
+        measure(deterministicConstruction);
+        std::cout << "; balanced ";
+        measure(balancedConstruction);
+        std::cout << "\n";
+    }
+}
+
+// Run the MCO tick benchmark, which measures how many ticks per second the colony achieves
+// with the configured MCO parameters and without an improvement heuristic.
+void runBenchTick(const Configuration& configuration)
+{
+    using fracSecs = std::chrono::duration<double>;
+
+    // improvement that leaves every solution as it is
+    struct NoStep : public Step
+    {
+        NoStep() : Step(std::make_unique<TwoExchangeNeighborhood>()) {}
+        void step(Solution&) override {}
+    };
+
+    for (const auto& inputFile : configuration.inputFiles) {
+        const auto problem = readProblemFile(inputFile);
+        auto mco = Mco(configuration.iterations, configuration.popsize,
+            configuration.evaporation, configuration.elitism,
+            configuration.minPheromone, configuration.maxPheromone,
+            configuration.pheromoneAttraction, configuration.objectiveAttraction,
+            configuration.intensification, configuration.reinforceStrategy,
+            std::make_shared<Random>(1), std::make_unique<LocalSearch>(std::make_unique<NoStep>()),
+            configuration.candidates);
+
+        const auto begin = std::chrono::steady_clock::now();
+        const auto result = mco.search(problem);
+        const auto end = std::chrono::steady_clock::now();
+
+        const auto seconds = std::chrono::duration_cast<fracSecs>(end - begin).count();
+        std::cout << inputFile.filename() << " (" << problem.vertices() << " vertices): "
+            << mco.elapsedTicks() << " ticks, " << mco.elapsedTicks() / seconds << " ticks/s, best "
+            << result.objective() << "\n";
+    }
+}
+
+// Convert all input files into the binary instance format, next to the originals.
+void compileInstances(const Configuration& configuration)
+{
+    for (const auto& inputFile : configuration.inputFiles) {
+        auto binaryFile = inputFile;
+        binaryFile.replace_extension(".bin");
+
+        if (binaryFile == inputFile) {
+            std::cout << "Skipping " << inputFile.filename() << " - already compiled.\n";
+            continue;
+        }
+
+        std::cout << "Compiling problem: " << inputFile.filename() << " - ";
+        const auto problem = readProblemFile(inputFile);
+        writeBinaryProblemFile(problem, binaryFile);
+        std::cout << "written to " << binaryFile.filename() << ".\n";
+    }
+
+    std::cout << "All done.\n";
+}
+
 // run() is like the main function, but may throw exceptions.
 void run(int argc, const char* argv[])
 {
     Configuration configuration;
     configuration.readArgv(argc, argv);
 
+    if (configuration.compileInstance) {
+        compileInstances(configuration);
+        return;
+    }
+
     switch (configuration.suite) {
     case Configuration::Suite::SINGLE:
         runFromConfiguration(configuration);
@@ -145,6 +488,30 @@ void run(int argc, const char* argv[])
         runPopsizeMco(configuration);
         break;
 
+    case Configuration::Suite::BENCH_LOAD:
+        runBenchLoad(configuration);
+        break;
+
+    case Configuration::Suite::BENCH_TOUR:
+        runBenchTour(configuration);
+        break;
+
+    case Configuration::Suite::BENCH_STEP:
+        runBenchStep(configuration);
+        break;
+
+    case Configuration::Suite::BENCH_DESCENT:
+        runBenchDescent(configuration);
+        break;
+
+    case Configuration::Suite::BENCH_CONSTRUCTION:
+        runBenchConstruction(configuration);
+        break;
+
+    case Configuration::Suite::BENCH_TICK:
+        runBenchTick(configuration);
+        break;
+
     default:
         assert(0);
 
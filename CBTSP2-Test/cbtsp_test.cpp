@@ -1,7 +1,19 @@
 // tests for basic definitions and operations
 #include "gtest/gtest.h"
+#include <stdexcept>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <random>
 
 import cbtsp;
+import util;
 
 class CbtspTest : public ::testing::Test
 {
@@ -44,6 +56,152 @@ TEST_F(CbtspTest, BigM)
     EXPECT_EQ(10, problem.value(3, 1));
 }
 
+// Ensure that malformed texts are rejected with the appropriate error.
+TEST_F(CbtspTest, FromTextMalformed)
+{
+    EXPECT_THROW(Problem::fromText("3"), std::runtime_error);
+    EXPECT_THROW(Problem::fromText("3 3\n0 1 1\n0 2 -1\n1 2\n"), std::runtime_error);
+    EXPECT_THROW(Problem::fromText("3 3\n0 1 1\n0 3 -1\n1 2 3\n"), std::out_of_range);
+    EXPECT_THROW(Problem::fromText("3 3\n0 1 1\n-1 2 -1\n1 2 3\n"), std::out_of_range);
+    EXPECT_THROW(Problem::fromText("3 3\n0 1 1\n2 2 -1\n1 2 3\n"), std::invalid_argument);
+}
+
+// Ensure that duplicate edges in the text are rejected.
+TEST_F(CbtspTest, FromTextDuplicate)
+{
+    const auto text = "3 3\n0 1 1\n0 2 -1\n1 0 3\n";
+    EXPECT_THROW(Problem::fromText(text), std::invalid_argument);
+}
+
+// Ensure that the sparse edge table stores edges symmetrically and sorted.
+TEST_F(CbtspTest, SparseEdgeTable)
+{
+    auto table = SparseEdgeTable<Value>{ 5, 100 };
+    EXPECT_TRUE(table.insert(3, 1, 7));
+    EXPECT_TRUE(table.insert(1, 0, -2));
+    EXPECT_TRUE(table.insert(4, 1, 5));
+    EXPECT_FALSE(table.insert(1, 3, 9));
+
+    EXPECT_EQ(7, table.at(1, 3));
+    EXPECT_EQ(7, table.at(3, 1));
+    EXPECT_EQ(100, table.at(2, 3));
+    EXPECT_TRUE(table.contains(0, 1));
+    EXPECT_FALSE(table.contains(0, 4));
+
+    const auto neighbors = table.neighbors(1);
+    ASSERT_EQ(3, neighbors.size());
+    EXPECT_EQ(0, neighbors[0]);
+    EXPECT_EQ(3, neighbors[1]);
+    EXPECT_EQ(4, neighbors[2]);
+    EXPECT_EQ(5, table.values(1)[2]);
+}
+
+// Ensure that problems with very many vertices are supported.
+TEST_F(CbtspTest, LargeProblem)
+{
+    auto problem = Problem{ 200000ull, 100l };
+    problem.addEdge({ 199999, 70000, 5 });
+    problem.addEdge({ 0, 199999, -3 });
+    EXPECT_EQ(5, problem.value(70000, 199999));
+    EXPECT_EQ(-3, problem.value(199999, 0));
+    EXPECT_EQ(100, problem.value(70000, 0));
+    EXPECT_EQ(2, problem.neighbors(199999).size());
+}
+
+// Ensure that problems survive the round-trip through the binary format.
+TEST_F(CbtspTest, Binary)
+{
+    const auto path = std::filesystem::temp_directory_path() / "cbtsp_binary_test.bin";
+    const auto text = "4 5\n0 1 1\n0 2 -1\n1 2 3\n2 3 5\n3 0 0\n";
+    const auto original = Problem::fromText(text);
+    {
+        auto stream = std::ofstream{ path, std::ios_base::binary };
+        original.writeBinary(stream);
+    }
+
+    {
+        auto file = std::make_shared<const MappedFile>(path);
+        ASSERT_TRUE(Problem::isBinary(file->view()));
+        const auto problem = Problem::fromBinary(file);
+        EXPECT_EQ(4, problem.vertices());
+        EXPECT_EQ(10, problem.bigM());
+        EXPECT_EQ(-1, problem.min());
+        EXPECT_EQ(5, problem.max());
+        EXPECT_EQ(3, problem.value(2, 1));
+        EXPECT_EQ(10, problem.value(3, 1));
+        EXPECT_EQ(3, problem.neighbors(2).size());
+    }
+
+    // corrupt one edge value
+    {
+        auto stream = std::fstream{ path, std::ios_base::in | std::ios_base::out | std::ios_base::binary };
+        stream.seekp(-1, std::ios_base::end);
+        stream.put('\x7f');
+    }
+
+    EXPECT_THROW(Problem::fromBinary(std::make_shared<const MappedFile>(path)), std::runtime_error);
+    std::filesystem::remove(path);
+}
+
+// Ensure that binary problems with a corrupt header or edge table are rejected.
+TEST_F(CbtspTest, BinaryCorrupt)
+{
+    const auto path = std::filesystem::temp_directory_path() / "cbtsp_binary_corrupt_test.bin";
+    const auto original = Problem::fromText("4 5\n0 1 1\n0 2 -1\n1 2 3\n2 3 5\n3 0 0\n");
+
+    const auto writeFile = [&path](const std::vector<std::uint64_t>& words)
+    {
+        auto stream = std::ofstream{ path, std::ios_base::binary };
+        stream.write(reinterpret_cast<const char*>(words.data()), words.size() * sizeof(std::uint64_t));
+    };
+
+    const auto load = [&path]()
+    {
+        return Problem::fromBinary(std::make_shared<const MappedFile>(path));
+    };
+
+    std::vector<std::uint64_t> words;
+    {
+        std::ostringstream stream;
+        original.writeBinary(stream);
+        const auto bytes = stream.str();
+        words.resize(bytes.size() / sizeof(std::uint64_t));
+        std::memcpy(words.data(), bytes.data(), bytes.size());
+    }
+
+    // header layout: magic, version, vertices, entries, bigM, min, max, checksum
+    // payload layout: 5 offsets, 10 neighbors in 5 words, 10 values
+    constexpr std::size_t bigMWord = 4, checksumWord = 7, neighborWord = 8 + 5;
+
+    // the same FNV-1a checksum as the writer, to forge consistent files
+    const auto fixChecksum = [checksumWord](std::vector<std::uint64_t>& words)
+    {
+        words[checksumWord] = 0;
+        std::uint64_t hash = 0xcbf29ce484222325ull;
+        for (const std::uint64_t word : words)
+            hash = (hash ^ word) * 0x100000001b3ull;
+        words[checksumWord] = hash;
+    };
+
+    auto corrupt = words;
+    fixChecksum(corrupt);
+    ASSERT_EQ(words, corrupt); // the forged checksum matches the real one
+
+    // a different big M does not change the file size, only the checksum detects it
+    corrupt[bigMWord] = 1000;
+    writeFile(corrupt);
+    EXPECT_THROW(load(), std::runtime_error);
+
+    // neighbor vertex 7 does not exist, even though the checksum is correct
+    corrupt = words;
+    corrupt[neighborWord] = (corrupt[neighborWord] & 0xffffffff00000000ull) | 7;
+    fixChecksum(corrupt);
+    writeFile(corrupt);
+    EXPECT_THROW(load(), std::runtime_error);
+
+    std::filesystem::remove(path);
+}
+
 // Ensure that the objective value of the solution is
 // correctly computed from the sum of edge values.
 TEST_F(CbtspTest, SolutionObjective)
@@ -68,6 +226,61 @@ TEST_F(CbtspTest, TwoOpt)
     EXPECT_EQ(105, solution.value());
 }
 
+// Ensure that the two-level tour reverses like a plain array.
+TEST(TwoLevelTour, Reverse)
+{
+    auto expected = std::vector<Vertex>(200);
+    std::iota(expected.begin(), expected.end(), Vertex{ 0 });
+    auto tour = TwoLevelTour(expected);
+    auto random = Random(7);
+    auto distribution = std::uniform_int_distribution<std::size_t>(0, expected.size());
+    auto actual = std::vector<Vertex>();
+
+    for (int i = 0; i < 1000; i++) {
+        const std::size_t a = distribution(random);
+        const std::size_t b = distribution(random);
+        const auto [low, high] = std::minmax(a, b);
+        std::reverse(expected.begin() + low, expected.begin() + high);
+        tour.reverse(low, high);
+    }
+
+    tour.copyTo(actual);
+    EXPECT_EQ(expected, actual);
+
+    for (std::size_t pos = 0; pos < expected.size(); pos++) {
+        const Vertex vertex = expected[pos];
+        EXPECT_EQ(vertex, tour.at(pos));
+        EXPECT_EQ(pos, tour.position(vertex));
+        EXPECT_EQ(expected[(pos + 1) % expected.size()], tour.next(vertex));
+        EXPECT_EQ(expected[(pos + expected.size() - 1) % expected.size()], tour.prev(vertex));
+    }
+}
+
+// Test the cyclic between query of the two-level tour.
+TEST(TwoLevelTour, Between)
+{
+    auto tour = TwoLevelTour({ 4, 2, 0, 3, 1 });
+    EXPECT_TRUE(tour.between(2, 0, 1));
+    EXPECT_FALSE(tour.between(0, 2, 1));
+    EXPECT_TRUE(tour.between(1, 4, 2));
+    EXPECT_TRUE(tour.between(3, 3, 3));
+}
+
+// Ensure that the two-level layout produces the same moves as the array layout.
+TEST_F(CbtspTest, TwoOptTwoLevel)
+{
+    auto solution = Solution(problem, { 0, 1, 2, 3 });
+    solution.setLayout(TourLayout::TWO_LEVEL);
+    EXPECT_EQ(TourLayout::TWO_LEVEL, solution.layout());
+    EXPECT_EQ(105, solution.twoOptValue(0, 2));
+    solution.twoOpt(2, 0);
+    EXPECT_EQ(1, solution.vertexAt(0));
+    EXPECT_EQ("1 0 2 3", solution.representation());
+    EXPECT_EQ(105, solution.value());
+    solution.setLayout(TourLayout::ARRAY);
+    EXPECT_EQ("1 0 2 3", solution.representation());
+}
+
 // Ensure that the the solution is correctly normalized.
 TEST_F(CbtspTest, Normalize)
 {
@@ -1,5 +1,6 @@
 // tests for program configuration
 #include "gtest/gtest.h"
+#include <stdexcept>
 
 import config;
 
@@ -8,3 +9,18 @@ TEST(Config, BasicParse)
 {
 	// TODO: implementation
 }
+
+// Ensure that benchmark suites reject configurations without runs to average over.
+TEST(Config, BenchmarkRuns)
+{
+	const char* valid[] = { "cbtsp", "--suite", "bench-load", "-r", "1" };
+	auto configuration = Configuration{};
+	configuration.readArgv(5, valid);
+	EXPECT_EQ(1, configuration.runs);
+
+	const char* noRuns[] = { "cbtsp", "--suite", "bench-load", "-r", "0" };
+	EXPECT_THROW(Configuration{}.readArgv(5, noRuns), std::out_of_range);
+
+	const char* noIterations[] = { "cbtsp", "--suite", "bench-step", "-i", "0" };
+	EXPECT_THROW(Configuration{}.readArgv(5, noIterations), std::out_of_range);
+}
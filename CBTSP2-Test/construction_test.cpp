@@ -2,9 +2,13 @@
 #include "gtest/gtest.h"
 #include <algorithm>
 #include <random>
+#include <limits>
+#include <cstdlib>
 
 import construction;
 
+#include "test_problems.h"
+
 class ConstructionTest : public ::testing::Test
 {
 
@@ -45,6 +49,27 @@ TEST_F(ConstructionTest, SelectRandom)
     EXPECT_EQ(availables[0] , selection);
 }
 
+// Ensure that the vertex pool keeps exactly the vertices which have not been removed.
+TEST_F(ConstructionTest, VertexPool)
+{
+    auto pool = VertexPool(problem, Solution(problem, { 3, 1 }));
+    EXPECT_EQ(3, pool.size());
+    EXPECT_FALSE(pool.contains(1));
+    EXPECT_FALSE(pool.contains(3));
+
+    pool.remove(0);
+    pool.remove(4);
+    EXPECT_EQ(1, pool.size());
+    EXPECT_EQ(2, pool[0]);
+    EXPECT_TRUE(pool.contains(2));
+    EXPECT_FALSE(pool.contains(0));
+    EXPECT_FALSE(pool.contains(4));
+
+    pool.remove(2);
+    EXPECT_EQ(0, pool.size());
+    EXPECT_FALSE(pool.contains(2));
+}
+
 // Ensure that the farthest vertex is always selected.
 TEST_F(ConstructionTest, SelectFarthestCity)
 {
@@ -55,6 +80,94 @@ TEST_F(ConstructionTest, SelectFarthestCity)
     EXPECT_EQ(2, selector.select(problem, Solution(problem, { 0, 3, 4 })));
 }
 
+// Ensure that the farthest selection, which merges one vertex per call while the tour grows,
+// always agrees with a selection from scratch and with the brute-force distances.
+TEST(ConstructionFarthest, SelectFarthestIncremental)
+{
+    // leave some pairs at big M, some real edges are even farther
+    const auto problem = randomProblem(17, 11, 200, -1500, 1500, .8);
+
+    // minimum absolute edge value from the vertex to the tour
+    const auto distance = [&problem](const Solution& solution, Vertex vertex)
+    {
+        Value distance = std::numeric_limits<Value>::max();
+        for (const Vertex v : solution.vertices())
+            distance = std::min(distance, std::abs(problem.value(v, vertex)));
+        return distance;
+    };
+
+    auto selector = FarthestCitySelector();
+    auto inserter = BestTourInserter();
+    auto solution = Solution(problem, {});
+    auto pool = VertexPool(problem.vertices());
+
+    while (pool.size() > 0) {
+        const Vertex next = selector.select(problem, solution, pool);
+        EXPECT_EQ(next, FarthestCitySelector().select(problem, solution));
+
+        // the lowest vertex stands unless one which is not big-M away is farther,
+        // then the lowest of the farthest is chosen
+        if (solution.length() > 0) {
+            Vertex expected = pool[0];
+            for (std::size_t i = 0; i < pool.size(); i++)
+                expected = std::min(expected, pool[i]);
+
+            const Value lowestDistance = distance(solution, expected);
+            Value farthestDistance = lowestDistance;
+            for (std::size_t i = 0; i < pool.size(); i++) {
+                const Value candidate = distance(solution, pool[i]);
+                if (candidate != problem.bigM() && (candidate > farthestDistance ||
+                    (candidate == farthestDistance && farthestDistance > lowestDistance && pool[i] < expected))) {
+                    expected = pool[i];
+                    farthestDistance = candidate;
+                }
+            }
+
+            EXPECT_EQ(expected, next);
+        }
+
+        pool.remove(next);
+        inserter.insert(problem, solution, next);
+    }
+
+    EXPECT_FALSE(solution.isPartial());
+}
+
+// Ensure that the balanced selection always leads to the lowest absolute tour value,
+// whether the selector follows the construction or starts from scratch.
+TEST(ConstructionBalanced, SelectBalanced)
+{
+    const auto problem = randomProblem(13, 7, 1000, -100, 100, .75);
+
+    auto selector = BalancedSelector();
+    auto inserter = BestTourInserter();
+    auto solution = Solution(problem, {});
+    auto pool = VertexPool(problem.vertices());
+
+    while (pool.size() > 0) {
+        const Vertex next = selector.select(problem, solution, pool);
+        EXPECT_EQ(next, BalancedSelector().select(problem, solution));
+
+        // compare with the best insertion of every remaining vertex
+        const auto bestObjective = [&problem](Solution solution, Vertex vertex)
+        {
+            BestTourInserter().insert(problem, solution, vertex);
+            return solution.objective();
+        };
+
+        if (solution.length() >= 2) {
+            const Value objective = bestObjective(solution, next);
+            for (std::size_t i = 0; i < pool.size(); i++)
+                EXPECT_LE(objective, bestObjective(solution, pool[i]));
+        }
+
+        pool.remove(next);
+        inserter.insert(problem, solution, next);
+    }
+
+    EXPECT_FALSE(solution.isPartial());
+}
+
 // Ensure that inserting places the new vertex at the best spot in the tour.
 TEST_F(ConstructionTest, BestTourInserter)
 {
@@ -99,9 +212,10 @@ TEST_F(ConstructionTest, InitialCitySelection)
     {
         MockSelector(int& count) : count_(count) {}
         int& count_;
-        Vertex select(const Problem& problem, const Solution& partialSolution)
+        Vertex select(const Problem& problem, const Solution& partialSolution, const VertexPool& pool)
         {
             count_++;
+            EXPECT_EQ(problem.vertices() - partialSolution.length(), pool.size());
             switch (count_) {
             case 1:
                 EXPECT_EQ("", partialSolution.representation());
@@ -1,6 +1,7 @@
 // tests for the GRASP implementation
 #include "gtest/gtest.h"
 #include <cassert>
+#include <memory>
 
 import grasp;
 import cbtsp;
@@ -67,3 +68,28 @@ TEST(Grasp, BasicRun)
     actual.normalize();
     EXPECT_EQ(actual.vertices(), globalOpt.vertices());
 }
+
+// Test that parallel Grasp finds the same solution regardless of the number of threads.
+TEST(Grasp, ParallelRun)
+{
+    auto problem = Problem{ 30, 1000l };
+    for (Vertex v = 0; v < 30; v++) {
+        problem.addEdge({ v, (v + 1) % 30, static_cast<Value>(v * 37 % 23) - 11 });
+        problem.addEdge({ v, (v + 7) % 30, static_cast<Value>(v * 13 % 19) - 9 });
+    }
+
+    const auto buildWorker = []()
+    {
+        auto random = std::make_shared<Random>();
+        auto construction = std::make_unique<RandomConstruction>(RandomSelector(random), BestTourInserter());
+        auto step = std::make_unique<BestImprovement>(std::make_unique<TwoExchangeNeighborhood>());
+        return GraspWorker{ move(construction), std::make_unique<LocalSearch>(move(step)), random };
+    };
+
+    auto serial = Grasp(buildWorker, 20, 1, std::make_shared<Random>(3));
+    auto parallel = Grasp(buildWorker, 20, 4, std::make_shared<Random>(3));
+    const Solution expected = serial.search(problem);
+    const Solution actual = parallel.search(problem);
+    EXPECT_EQ(expected.vertices(), actual.vertices());
+    EXPECT_EQ(expected.value(), actual.value());
+}
@@ -6,9 +6,17 @@
 #include <iterator>
 #include <utility>
 #include <memory>
+#include <random>
+#include <numeric>
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
 
 import cbtsp;
 import local;
+import util;
+
+#include "test_problems.h"
 
 class LocalTest : public ::testing::Test
 {
@@ -87,6 +95,236 @@ TEST_F(LocalTest, VertexShiftNeighborhood)
     EXPECT_TRUE(expected.empty());
 }
 
+// Ensure that seeking a neighbor arrives at the same neighbor as advancing the iterator.
+TEST(LocalSeek, SameAsIterator)
+{
+    const std::vector<std::function<std::unique_ptr<TwoExchangeNeighborhood>()>> factories = {
+        [] { return std::make_unique<TwoExchangeNeighborhood>(); },
+        [] { return std::make_unique<TwoExchangeNeighborhood>(2, 2); },
+        [] { return std::make_unique<TwoExchangeNeighborhood>(3, 5); },
+        [] { return std::make_unique<NarrowNeighborhood>(); },
+        [] { return std::make_unique<WideNeighborhood>(); }
+    };
+
+    for (const auto& factory : factories) {
+        for (std::size_t vertices = 5; vertices < 20; vertices++) {
+            auto it = factory();
+            auto sought = factory();
+            it->reset(vertices);
+            sought->reset(vertices);
+
+            for (std::size_t index = 0; ; index++) {
+                sought->seek(index);
+                ASSERT_EQ(it->current(), sought->current());
+                ASSERT_EQ(*it != std::default_sentinel, *sought != std::default_sentinel);
+
+                if (!(*it != std::default_sentinel))
+                    break;
+
+                ++*it;
+            }
+        }
+    }
+}
+
+// Ensure that a recorded Move produces the same neighbor as the neighborhood it came from.
+TEST_F(LocalTest, Move)
+{
+    auto solution = Solution(problem, { 0, 1, 2, 3, 4 });
+    auto it = TwoExchangeNeighborhood();
+    it.reset(5);
+    ++it;
+
+    const Move move = it.current();
+    EXPECT_EQ(Move::Kind::TWO_EXCHANGE, move.kind);
+    const Solution expected = it.applyCopy(solution);
+
+    ++it;
+    EXPECT_NE(move, it.current());
+
+    move.apply(solution);
+    EXPECT_EQ(expected.vertices(), solution.vertices());
+    EXPECT_EQ(expected.value(), solution.value());
+
+    Move().apply(solution);
+    EXPECT_EQ(expected.vertices(), solution.vertices());
+}
+
+// Ensure that the statically dispatched steps walk the same way as the virtual steps.
+TEST_F(LocalTest, StaticStep)
+{
+    auto dynamicSolution = Solution(problem, { 0, 2, 4, 1, 3 });
+    auto staticSolution = dynamicSolution;
+    auto dynamicStep = BestImprovement(std::make_unique<TwoExchangeNeighborhood>());
+    auto staticStep = BasicBestImprovement<TwoExchangeNeighborhood>(std::make_unique<TwoExchangeNeighborhood>());
+
+    for (int i = 0; i < 3; i++) {
+        dynamicStep.step(dynamicSolution);
+        staticStep.step(staticSolution);
+        EXPECT_EQ(dynamicSolution.vertices(), staticSolution.vertices());
+    }
+
+    auto firstStep = BasicFirstImprovement<TwoExchangeNeighborhood>(std::make_unique<TwoExchangeNeighborhood>());
+    auto search = LocalSearch(std::make_unique<BasicBestImprovement<TwoExchangeNeighborhood>>(
+        std::make_unique<TwoExchangeNeighborhood>()));
+    firstStep.step(staticSolution);
+    auto actual = search.search(staticSolution);
+    actual.normalize();
+    EXPECT_EQ(Solution(problem, { 0, 1, 2, 3, 4 }).vertices(), actual.vertices());
+}
+
+// Ensure that the row kernels find the same sums as a plain loop, including ties.
+TEST(LocalKernel, MinAbsSum)
+{
+    auto random = Random(3);
+    auto distribution = std::uniform_int_distribution<Value>(-5, 5);
+    std::vector<Value> a(40), b(40), c(40);
+
+    for (std::size_t count = 0; count < a.size(); count++) {
+        for (std::size_t i = 0; i < count; i++) {
+            a[i] = distribution(random);
+            b[i] = distribution(random);
+            c[i] = distribution(random);
+        }
+
+        std::size_t expectedIndex = count;
+        Value expectedMin = std::numeric_limits<Value>::max();
+        std::size_t expectedFirst = count;
+
+        for (std::size_t i = 0; i < count; i++) {
+            const Value objective = std::abs(1 + a[i] + b[i] - c[i]);
+            if (objective < expectedMin) {
+                expectedIndex = i;
+                expectedMin = objective;
+            }
+            if (objective < 3 && expectedFirst == count)
+                expectedFirst = i;
+        }
+
+        const auto [index, min] = minAbsSum(1, a.data(), b.data(), c.data(), count);
+        if (count > 0) {
+            EXPECT_EQ(expectedIndex, index);
+            EXPECT_EQ(expectedMin, min);
+        }
+        EXPECT_EQ(expectedFirst, firstAbsSumBelow(1, a.data(), b.data(), c.data(), count, 3));
+    }
+}
+
+// Ensure that the row-wise scans choose the same neighbors as iterating over the neighborhood.
+TEST(LocalRowScan, SameAsIterator)
+{
+    const std::size_t vertices = 37;
+    const auto problem = randomProblem(vertices, 5, 1000, -50, 50, 2. / 3);
+    auto random = Random(5);
+    auto tour = std::vector<Vertex>(vertices);
+    std::iota(tour.begin(), tour.end(), Vertex{ 0 });
+    std::shuffle(tour.begin(), tour.end(), random);
+    const auto solution = Solution(problem, std::move(tour));
+
+    auto neighborhoods = std::vector<std::unique_ptr<TwoExchangeNeighborhood>>();
+    neighborhoods.push_back(std::make_unique<TwoExchangeNeighborhood>());
+    neighborhoods.push_back(std::make_unique<TwoExchangeNeighborhood>(2, 2));
+    neighborhoods.push_back(std::make_unique<TwoExchangeNeighborhood>(5, 11));
+    neighborhoods.push_back(std::make_unique<NarrowNeighborhood>());
+    neighborhoods.push_back(std::make_unique<WideNeighborhood>());
+
+    for (const auto& neighborhood : neighborhoods) {
+        neighborhood->reset(vertices); // both scans start from the same limits
+
+        for (const Value bound : { solution.objective(), Value{ 10 }, Value{ 0 } }) {
+            EXPECT_EQ(neighborhood->Neighborhood::bestMove(solution, bound), neighborhood->bestMove(solution, bound));
+            EXPECT_EQ(neighborhood->Neighborhood::firstMove(solution, bound), neighborhood->firstMove(solution, bound));
+        }
+    }
+}
+
+// Ensure that the don't-look scan of the first active vertex finds the best of its moves.
+TEST(LocalRowScan, ActiveMove)
+{
+    const std::size_t vertices = 37;
+    const auto problem = randomProblem(vertices, 9, 1000, -50, 50, .5);
+    auto random = Random(9);
+    auto tour = std::vector<Vertex>(vertices);
+    std::iota(tour.begin(), tour.end(), Vertex{ 0 });
+    std::shuffle(tour.begin(), tour.end(), random);
+    const auto solution = Solution(problem, std::move(tour));
+
+    // the first active vertex is at position 0, so its tour edges are the cuts 0 and 1
+    auto expected = solution.objective();
+    auto it = TwoExchangeNeighborhood();
+    for (it.reset(vertices); it != std::default_sentinel; ++it) {
+        const Move move = it.current();
+        if (move.cut1 <= 1)
+            expected = std::min(expected, it.objective(solution));
+    }
+
+    auto neighborhood = TwoExchangeNeighborhood();
+    neighborhood.activateAll(solution);
+    const Move move = neighborhood.activeMove(solution, solution.objective());
+    ASSERT_EQ(Move::Kind::TWO_EXCHANGE, move.kind);
+    EXPECT_TRUE(move.cut1 <= 1);
+    EXPECT_EQ(expected, std::abs(solution.twoOptValue(move.cut1, move.cut2)));
+
+    // the descent only ends in a local optimum
+    auto search = LocalSearch(std::make_unique<DontLookImprovement>(std::make_unique<TwoExchangeNeighborhood>()));
+    const auto optimum = search.search(solution);
+    EXPECT_LT(optimum.objective(), solution.objective());
+    EXPECT_EQ(Move::Kind::NONE, TwoExchangeNeighborhood().bestMove(optimum, optimum.objective()).kind);
+}
+
+// Ensure that the descent with don't-look bits improves the solution.
+TEST_F(LocalTest, DontLookSearch)
+{
+    const auto optimum = Solution(problem, { 0, 1, 2, 3, 4 });
+    auto start = Solution(problem, { 0, 1, 3, 4, 2 }); // 2 steps from optimum
+
+    auto step = std::make_unique<DontLookImprovement>(std::make_unique<TwoExchangeNeighborhood>());
+    auto search = LocalSearch(move(step));
+    auto actual = search.search(start);
+    actual.normalize();
+    EXPECT_EQ(optimum.vertices(), actual.vertices());
+
+    // the step must start over for a new descent
+    actual = search.search(start);
+    actual.normalize();
+    EXPECT_EQ(optimum.vertices(), actual.vertices());
+}
+
+// Ensure that best improvement with the delta cache or index takes the same steps as without.
+TEST(LocalRowScan, DeltaStore)
+{
+    const std::size_t vertices = 29;
+    const auto problem = randomProblem(vertices, 4, 1000, 0, 100, .5);
+    auto random = Random(4);
+    auto tour = std::vector<Vertex>(vertices);
+    std::iota(tour.begin(), tour.end(), Vertex{ 0 });
+    std::shuffle(tour.begin(), tour.end(), random);
+    const auto start = Solution(problem, std::move(tour));
+
+    for (const DeltaStore store : { DeltaStore::CACHE, DeltaStore::INDEX }) {
+        auto plain = BasicBestImprovement<TwoExchangeNeighborhood>(std::make_unique<TwoExchangeNeighborhood>());
+        auto stored = BasicBestImprovement<TwoExchangeNeighborhood>(std::make_unique<TwoExchangeNeighborhood>(), store);
+        auto plainNarrow = BasicBestImprovement<NarrowNeighborhood>(std::make_unique<NarrowNeighborhood>());
+        auto storedNarrow = BasicBestImprovement<NarrowNeighborhood>(std::make_unique<NarrowNeighborhood>(), store);
+        auto expected = start;
+        auto actual = start;
+
+        for (int i = 0; i < 30; i++) {
+            plain.step(expected);
+            stored.step(actual);
+            ASSERT_EQ(expected.vertices(), actual.vertices());
+            EXPECT_EQ(expected.value(), actual.value());
+
+            // changes from outside the step invalidate the stored values
+            if (i % 4 == 3) {
+                plainNarrow.step(expected);
+                storedNarrow.step(actual);
+                ASSERT_EQ(expected.vertices(), actual.vertices());
+            }
+        }
+    }
+}
+
 TEST_F(LocalTest, Search)
 {
     const auto optimum = Solution(problem, { 0, 1, 2, 3, 4 });
@@ -100,3 +338,34 @@ TEST_F(LocalTest, Search)
 
     EXPECT_EQ(optimum.vertices(), actual.vertices());
 }
+
+// Ensure that the parallel row-wise scan chooses the same neighbors as the serial scan.
+TEST(LocalRowScan, Parallel)
+{
+    const std::size_t vertices = TwoExchangeNeighborhood::parallelMinVertices;
+    // about 6 edges per vertex, and the tour value is near 0, so many neighbors tie for the best
+    const auto problem = randomProblem(vertices, 6, 0, -2, 2, 6. / vertices);
+    auto random = Random(6);
+    auto tour = std::vector<Vertex>(vertices);
+    std::iota(tour.begin(), tour.end(), Vertex{ 0 });
+    std::shuffle(tour.begin(), tour.end(), random);
+    const auto solution = Solution(problem, std::move(tour));
+
+    auto neighborhoods = std::vector<std::unique_ptr<TwoExchangeNeighborhood>>();
+    neighborhoods.push_back(std::make_unique<TwoExchangeNeighborhood>());
+    neighborhoods.push_back(std::make_unique<NarrowNeighborhood>());
+    neighborhoods.push_back(std::make_unique<WideNeighborhood>());
+
+    // the pools and the rows of the threads are reused across scans
+    auto smallPool = ThreadPool(3);
+    auto largePool = ThreadPool(8);
+
+    for (const auto& neighborhood : neighborhoods) {
+        for (const Value bound : { solution.objective(), Value{ 10 }, Value{ 0 } }) {
+            const Move expected = neighborhood->bestMove(solution, bound);
+            EXPECT_EQ(expected, neighborhood->bestMove(solution, bound, smallPool));
+            EXPECT_EQ(expected, neighborhood->bestMove(solution, bound, largePool));
+            EXPECT_EQ(expected, neighborhood->bestMove(solution, bound, smallPool));
+        }
+    }
+}
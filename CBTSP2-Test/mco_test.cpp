@@ -1,6 +1,12 @@
 // tests for the Mouse Colony Optimization
 #include "gtest/gtest.h"
 #include <memory>
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+#include <utility>
+#include <cmath>
 
 import mco;
 import cbtsp;
@@ -24,14 +30,14 @@ protected:
     ReinforceStrategy reinforceStrategy = ReinforceStrategy::LAMARCK;
     std::shared_ptr<Random> random = std::make_shared<Random>(); // random number generator
 
-    Mco buildMco(std::size_t vertices) const
+    Mco buildMco(std::size_t vertices, std::size_t candidates = 0) const
     {
         auto improvement = buildImprovement(vertices);
         return Mco(ticks, mice, evaporation, elitism,
             minPheromone, maxPheromone,
             pheromoneAttraction, objectiveAttraction,
             intensification, reinforceStrategy,
-            random, move(improvement));
+            random, move(improvement), candidates);
     }
 
     // construct the improvement heuristic
@@ -62,6 +68,332 @@ TEST_F(McoTest, BasicRun)
     EXPECT_TRUE(actual.isFeasible());
 }
 
+// Test that MCO with candidate lists can find a feasible solution, if available.
+TEST_F(McoTest, CandidateRun)
+{
+    auto problem = Problem{ 5, 10000l };
+    problem.addEdge({ 0, 1, 1000 });
+    problem.addEdge({ 1, 2, -1000 });
+    problem.addEdge({ 2, 3, 500 });
+    problem.addEdge({ 3, 4, 200 });
+    problem.addEdge({ 4, 0, -200 });
+    problem.addEdge({ 0, 2, -500 });
+
+    auto mco = buildMco(problem.vertices(), 2);
+    const Solution actual = mco.search(problem);
+    EXPECT_TRUE(actual.isFeasible());
+}
+
+// Test that the tour values of MCO with candidate lists are consistent with their vertices.
+TEST_F(McoTest, CandidateValue)
+{
+    auto problem = Problem{ 20, 10000l };
+    for (Vertex v = 0; v < 20; v++) {
+        problem.addEdge({ v, (v + 1) % 20, static_cast<Value>(v * 37 % 11) - 5 });
+        problem.addEdge({ v, (v + 7) % 20, static_cast<Value>(v * 13 % 17) - 8 });
+    }
+
+    ticks = 5;
+    mice = 10;
+    auto mco = buildMco(problem.vertices(), 1);
+    const Solution actual = mco.search(problem);
+    EXPECT_FALSE(actual.isPartial());
+    EXPECT_EQ(Solution(problem, std::vector<Vertex>(actual.vertices())).value(), actual.value());
+}
+
+// Test that parallel MCO finds the same solution regardless of the number of threads.
+TEST_F(McoTest, ParallelRun)
+{
+    auto problem = Problem{ 20, 10000l };
+    for (Vertex v = 0; v < 20; v++) {
+        problem.addEdge({ v, (v + 1) % 20, static_cast<Value>(v * 37 % 11) - 5 });
+        problem.addEdge({ v, (v + 7) % 20, static_cast<Value>(v * 13 % 17) - 8 });
+    }
+
+    ticks = 5;
+    mice = 10;
+    const auto buildImprovement = [](const std::shared_ptr<Random>&)
+    {
+        return McoTest::buildImprovement(20);
+    };
+    const auto buildParallelMco = [&](int threads)
+    {
+        return Mco(ticks, mice, evaporation, elitism,
+            minPheromone, maxPheromone,
+            pheromoneAttraction, objectiveAttraction,
+            intensification, reinforceStrategy,
+            std::make_shared<Random>(7), buildImprovement, threads);
+    };
+
+    auto serial = buildParallelMco(1);
+    auto parallel = buildParallelMco(3);
+    const Solution expected = serial.search(problem);
+    const Solution actual = parallel.search(problem);
+    EXPECT_EQ(expected.vertices(), actual.vertices());
+    EXPECT_EQ(expected.value(), actual.value());
+}
+
+// Dense model of the pheromone levels, with one level for every vertex pair.
+class DensePheromones
+{
+
+public:
+
+    DensePheromones(const Problem& problem, Pheromone init, Pheromone min, Pheromone max)
+        : problem_(problem), n_(problem.vertices()), min_(min), max_(max),
+        levels_(n_ * n_, init), deltas_(n_ * n_, 0.f)
+    {
+    }
+
+    Pheromone level(Vertex a, Vertex b) const
+    {
+        return levels_[std::min(a, b) * n_ + std::max(a, b)];
+    }
+
+    // largest pheromone change of any reinforcement so far
+    Pheromone reference() const
+    {
+        return reference_;
+    }
+
+    void reinforce(const Solution& solution, float scale = 1.f)
+    {
+        const Pheromone delta = scale / (static_cast<Pheromone>(solution.objective()) / (problem_.max() - problem_.min()));
+        reference_ = std::max(reference_, std::abs(delta));
+        Vertex prev = solution.vertices().back();
+        for (const Vertex v : solution.vertices()) {
+            deltas_[std::min(prev, v) * n_ + std::max(prev, v)] += delta;
+            prev = v;
+        }
+    }
+
+    void update(float evaporation)
+    {
+        for (std::size_t i = 0; i < levels_.size(); i++) {
+            const Pheromone level = levels_[i] + std::exchange(deltas_[i], 0.f);
+            levels_[i] = (1.f - evaporation) * std::min(std::max(level, min_), max_) + evaporation * min_;
+        }
+    }
+
+private:
+
+    const Problem& problem_;
+    std::size_t n_;
+    Pheromone min_;
+    Pheromone max_;
+    std::vector<Pheromone> levels_;
+    std::vector<Pheromone> deltas_;
+    Pheromone reference_ = 0.f;
+
+};
+
+class McoStateTest : public ::testing::Test
+{
+
+protected:
+
+    Problem problem{ 8, 100l };
+    std::size_t realEdges = 0;
+
+    McoStateTest()
+    {
+        // a ring of real edges, all other pairs are at big M
+        for (Vertex v = 0; v < 8; v++) {
+            problem.addEdge({ v, (v + 1) % 8, static_cast<Value>(v % 3) * 4 - 3 });
+            realEdges++;
+        }
+    }
+
+    // check that all pairs are close to the dense levels
+    void expectLevels(const McoState& state, const DensePheromones& dense, float pheromoneAttraction) const
+    {
+        for (Vertex a = 0; a < 8; a++) {
+            for (Vertex b = 0; b < 8; b++) {
+                if (a == b)
+                    continue;
+
+                const Pheromone expected = dense.level(a, b);
+                const Pheromone tolerance = 1e-3f * (expected + dense.reference());
+                EXPECT_NEAR(expected, state.pheromone(a, b), tolerance) << a << "-" << b;
+                EXPECT_NEAR(std::pow(expected, pheromoneAttraction), state.attraction(a, b),
+                    pheromoneAttraction * tolerance) << a << "-" << b;
+            }
+        }
+    }
+
+};
+
+// Test that pairs without an explicit level share the background level.
+TEST_F(McoStateTest, Background)
+{
+    auto state = McoState(problem, 1.f, .1f, 1.f, 2.f);
+    auto dense = DensePheromones(problem, 1.f, .1f, 1.f);
+    EXPECT_EQ(realEdges, state.explicitEdges());
+    EXPECT_EQ(1.f, state.pheromone(0, 4));
+    EXPECT_EQ(1.f, state.attraction(4, 0));
+
+    for (int tick = 0; tick < 5; tick++) {
+        state.update(.2f);
+        dense.update(.2f);
+    }
+
+    EXPECT_EQ(realEdges, state.explicitEdges());
+    EXPECT_EQ(dense.level(2, 6), state.pheromone(2, 6));
+    expectLevels(state, dense, 2.f);
+}
+
+// Test that a reinforced edge is dropped once it has decayed close to the background,
+// even if the lowest level is 0 and the background decays as well.
+TEST_F(McoStateTest, DropDecayed)
+{
+    auto state = McoState(problem, 1.f, 0.f, 1.f, 1.f);
+    auto dense = DensePheromones(problem, 1.f, 0.f, 1.f);
+
+    for (int tick = 0; tick < 5; tick++) {
+        state.update(.1f);
+        dense.update(.1f);
+    }
+
+    const auto solution = Solution(problem, { 0, 2, 4, 6, 1, 3, 5, 7 });
+    state.reinforce(solution);
+    dense.reinforce(solution);
+    state.update(.1f);
+    dense.update(.1f);
+    EXPECT_EQ(realEdges + 7, state.explicitEdges()); // 7-0 is a real edge
+    EXPECT_LT(state.pheromone(0, 4), state.pheromone(0, 2));
+
+    int ticks = 1;
+    while (state.explicitEdges() > realEdges && ticks < 1000) {
+        state.update(.1f);
+        dense.update(.1f);
+        expectLevels(state, dense, 1.f);
+        ticks++;
+    }
+
+    // well before the levels meet in the denormal range
+    EXPECT_EQ(realEdges, state.explicitEdges());
+    EXPECT_LT(ticks, 200);
+}
+
+// Test that dropping edges relinks the remaining edges correctly.
+TEST_F(McoStateTest, AddDrop)
+{
+    auto state = McoState(problem, 1.f, .1f, 1.f, 2.f);
+    auto dense = DensePheromones(problem, 1.f, .1f, 1.f);
+    const auto older = Solution(problem, { 0, 2, 4, 6, 1, 3, 5, 7 });
+    const auto newer = Solution(problem, { 0, 3, 6, 1, 4, 7, 2, 5 });
+
+    // below the highest level, reinforcements stand out from the background
+    for (int tick = 0; tick < 2; tick++) {
+        state.update(.5f);
+        dense.update(.5f);
+    }
+
+    state.reinforce(older);
+    dense.reinforce(older);
+    state.update(.5f);
+    dense.update(.5f);
+
+    for (int tick = 0; tick < 3; tick++) {
+        state.update(.5f);
+        dense.update(.5f);
+    }
+
+    state.reinforce(newer);
+    dense.reinforce(newer);
+    EXPECT_EQ(realEdges + 14, state.explicitEdges()); // 6-1 is in both tours
+
+    // the older edges go first, which moves the newer edges to their ids
+    bool partial = false;
+    for (int tick = 0; tick < 100; tick++) {
+        state.update(.5f);
+        dense.update(.5f);
+        expectLevels(state, dense, 2.f);
+        partial = partial || (state.explicitEdges() > realEdges && state.explicitEdges() < realEdges + 14);
+    }
+
+    EXPECT_TRUE(partial);
+    EXPECT_EQ(realEdges, state.explicitEdges());
+}
+
+// Test that a seeded run of reinforcements matches the dense pheromone levels.
+TEST_F(McoStateTest, DenseRun)
+{
+    auto state = McoState(problem, 1.f, .05f, 2.f, 1.5f);
+    auto dense = DensePheromones(problem, 1.f, .05f, 2.f);
+    auto random = Random(3);
+    auto vertices = std::vector<Vertex>{ 0, 1, 2, 3, 4, 5, 6, 7 };
+
+    for (int tick = 0; tick < 300; tick++) {
+        for (int mouse = 0; mouse < 3; mouse++) {
+            std::ranges::shuffle(vertices, random);
+            const auto solution = Solution(problem, std::vector<Vertex>(vertices));
+            const float scale = std::uniform_real_distribution<float>{ 0.f, 1.f }(random);
+            state.reinforce(solution, scale);
+            dense.reinforce(solution, scale);
+        }
+
+        state.update(.1f);
+        dense.update(.1f);
+        expectLevels(state, dense, 1.5f);
+    }
+}
+
+// Test that seeded mice construct the same tours as the Solution-based construction before
+// the dedicated tour array, which recorded these tours with the same seed.
+TEST(Mouse, SeededTours)
+{
+    auto problem = Problem{ 12, 1000l };
+    for (Vertex a = 0; a < 12; a++)
+        for (Vertex b = a + 1; b < 12; b++)
+            if ((a * 7 + b * 3) % 4 != 0)
+                problem.addEdge({ a, b, static_cast<Value>((a * 31 + b * 17) % 41) - 20 });
+
+    const auto construct = [&problem](std::size_t candidates)
+    {
+        auto state = McoState(problem, 1.f, .1f, 1.f, 2.f, candidates);
+        state.reinforce(Solution(problem, { 0, 2, 4, 6, 8, 10, 1, 3, 5, 7, 9, 11 }));
+        state.update(.5f);
+        auto mouse = Mouse(problem, state, 1.f, .3f, std::make_shared<Random>(5));
+
+        std::vector<std::string> tours;
+        for (int i = 0; i < 3; i++)
+            tours.push_back(mouse.construct().representation());
+        return tours;
+    };
+
+    const auto unrestricted = std::vector<std::string>{
+        "9 10 11 2 4 8 1 3 0 5 6 7",
+        "6 2 8 9 1 0 11 7 10 3 5 4",
+        "8 0 1 11 5 7 3 2 10 9 6 4" };
+    EXPECT_EQ(unrestricted, construct(0));
+
+    const auto restricted = std::vector<std::string>{
+        "6 7 10 3 0 1 9 5 2 8 11 4",
+        "4 11 0 6 7 10 3 8 9 5 2 1",
+        "11 4 6 0 1 9 5 2 7 10 8 3" };
+    EXPECT_EQ(restricted, construct(3));
+}
+
+// Test that MCO with linear pheromone attraction can find a feasible solution, if available.
+TEST_F(McoTest, LinearAttractionRun)
+{
+    auto problem = Problem{ 5, 10000l };
+    problem.addEdge({ 0, 1, 1000 });
+    problem.addEdge({ 1, 2, -1000 });
+    problem.addEdge({ 2, 3, 500 });
+    problem.addEdge({ 3, 4, 200 });
+    problem.addEdge({ 4, 0, -200 });
+    problem.addEdge({ 0, 2, -500 });
+
+    pheromoneAttraction = 1.f;
+    minPheromone = .1f;
+    maxPheromone = 1.f;
+    auto mco = buildMco(problem.vertices());
+    const Solution actual = mco.search(problem);
+    EXPECT_TRUE(actual.isFeasible());
+}
+
 // Test that MCO can find a good solution, if available.
 TEST_F(McoTest, EasyRun)
 {
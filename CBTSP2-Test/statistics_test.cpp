@@ -1,9 +1,18 @@
 // tests for statistics collection
 #include "gtest/gtest.h"
 #include <chrono>
+#include <memory>
+#include <numeric>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <string>
+#include <vector>
 
 import statistics;
 import cbtsp;
+import setup;
 
 // Ensure that statistics are correctly computed from records.
 TEST(Statistics, BasicRun)
@@ -36,3 +45,94 @@ TEST(Statistics, BasicRun)
     EXPECT_NEAR(1.f, statistics.stdevInfEdges(), .001f); // sqrt( 1/(2-1.5) * (0.25+0.25) )
     EXPECT_EQ(2s, statistics.medRuntime(), .001f);
 }
+
+// Search that returns a random tour.
+class RandomTourSearch : public Search
+{
+
+public:
+
+    explicit RandomTourSearch(const std::shared_ptr<Random>& random) : random_(random) {}
+
+    Solution search(const Problem& problem) override
+    {
+        auto vertices = std::vector<Vertex>(problem.vertices());
+        std::iota(vertices.begin(), vertices.end(), 0);
+        std::shuffle(vertices.begin(), vertices.end(), *random_);
+        return Solution{ problem, move(vertices) };
+    }
+
+private:
+
+    std::shared_ptr<Random> random_;
+
+};
+
+// Ensure that parallel measurements are reproducible regardless of the number of threads.
+TEST(Statistics, ParallelMeasure)
+{
+    auto problem = Problem{ 8ull, 100l };
+    for (Vertex v = 0; v < 8; v++)
+        problem.addEdge({ v, (v + 1) % 8, static_cast<Value>(v) - 3 });
+
+    const auto buildSearch = [](const std::shared_ptr<Random>& random)
+    {
+        return std::make_unique<RandomTourSearch>(random);
+    };
+
+    const auto serial = Statistics::measure("serial", buildSearch, problem, 50, 1, 42);
+    const auto parallel = Statistics::measure("parallel", buildSearch, problem, 50, 4, 42);
+
+    EXPECT_EQ(50, parallel.samples());
+    EXPECT_EQ(serial.feasibles(), parallel.feasibles());
+    EXPECT_EQ(serial.bestSolution()->representation(), parallel.bestSolution()->representation());
+    EXPECT_EQ(serial.meanInfEdges(), parallel.meanInfEdges());
+    EXPECT_EQ(serial.stdevInfEdges(), parallel.stdevInfEdges());
+}
+
+// Ensure that every instance of a batch has the same results as when it is measured on its own.
+TEST(Statistics, MeasureBatch)
+{
+    const auto directory = std::filesystem::temp_directory_path() / "cbtsp_batch_test";
+    std::filesystem::create_directories(directory);
+
+    // rings with a few chords, of different sizes so that the batch loads them in another order
+    auto inputFiles = std::vector<std::filesystem::path>();
+    for (const Vertex vertices : { 8u, 20u, 12u }) {
+        inputFiles.push_back(directory / ("ring" + std::to_string(vertices) + ".txt"));
+        auto stream = std::ofstream{ inputFiles.back() };
+        stream << vertices << " " << vertices + vertices / 2 << "\n";
+
+        for (Vertex v = 0; v < vertices; v++)
+            stream << v << " " << (v + 1) % vertices << " " << static_cast<Value>(v) - 3 << "\n";
+        for (Vertex v = 0; v < vertices; v += 2)
+            stream << v << " " << (v + vertices / 2 + 1) % vertices << " " << 5 - static_cast<Value>(v) << "\n";
+    }
+
+    const auto buildSearch = [](const std::shared_ptr<Random>& random)
+    {
+        return std::make_unique<RandomTourSearch>(random);
+    };
+
+    auto completed = std::set<std::filesystem::path>();
+    measureBatch(inputFiles, buildSearch, 30, 3, 42,
+        [&](const std::filesystem::path& inputFile, const Statistics& batch)
+        {
+            // the batch releases the instance after this call, so compare right away
+            const auto problem = readProblemFile(inputFile);
+            const auto single = Statistics::measure(batch.name(), buildSearch, problem, 30, 1, 42);
+
+            EXPECT_TRUE(completed.insert(inputFile).second);
+            EXPECT_EQ(inputFile.stem().string(), batch.name());
+            EXPECT_EQ(30, batch.samples());
+            EXPECT_EQ(single.feasibles(), batch.feasibles());
+            EXPECT_EQ(single.bestSolution()->representation(), batch.bestSolution()->representation());
+            EXPECT_EQ(single.meanObjective(), batch.meanObjective());
+            EXPECT_EQ(single.stdevObjective(), batch.stdevObjective());
+            EXPECT_EQ(single.meanInfEdges(), batch.meanInfEdges());
+            EXPECT_EQ(single.stdevInfEdges(), batch.stdevInfEdges());
+        });
+
+    EXPECT_EQ(inputFiles.size(), completed.size());
+    std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,34 @@
+// problem instances shared among the tests
+#pragma once
+#include <random>
+#include <cstddef>
+
+import cbtsp;
+
+/**
+ * Build a problem where every pair of vertices is connected by an edge with the given probability.
+ * The edge values are drawn uniformly from [minValue, maxValue], which may exceed big-M.
+ *
+ * @param vertices: number of vertices
+ * @param seed: seed of the random edges and values
+ * @param bigM: value of the pairs without an edge
+ * @param minValue: smallest edge value
+ * @param maxValue: largest edge value
+ * @param density: probability that a pair of vertices has an edge
+ * @return: the random problem
+ */
+inline Problem randomProblem(std::size_t vertices, unsigned seed, Value bigM,
+    Value minValue, Value maxValue, double density = 1.)
+{
+    auto random = Random(seed);
+    auto edgeDistribution = std::bernoulli_distribution(density);
+    auto valueDistribution = std::uniform_int_distribution<Value>(minValue, maxValue);
+    auto problem = Problem(vertices, bigM);
+
+    for (Vertex a = 0; a < vertices; a++)
+        for (Vertex b = a + 1; b < vertices; b++)
+            if (edgeDistribution(random))
+                problem.addEdge({ a, b, valueDistribution(random) });
+
+    return problem;
+}
@@ -2,6 +2,11 @@
 #include "gtest/gtest.h"
 #include <vector>
 #include <string>
+#include <filesystem>
+#include <fstream>
+#include <atomic>
+#include <stdexcept>
+#include <latch>
 
 import util;
 
@@ -17,3 +22,81 @@ TEST(UtilTest, Join)
 	const std::vector<std::string> parts = { "hello", "joining", "world" };
 	EXPECT_EQ("hello - joining - world", join(" - ", parts));
 }
+
+// Ensure that mapped files show the file contents
+TEST(UtilTest, MappedFile)
+{
+	const auto path = std::filesystem::temp_directory_path() / "cbtsp_mapped_file_test.txt";
+	std::ofstream{ path } << "3 3\n0 1 1\n";
+
+	{
+		const auto file = MappedFile{ path };
+		EXPECT_EQ("3 3\n0 1 1\n", file.view());
+	}
+
+	std::filesystem::remove(path);
+	EXPECT_THROW(MappedFile{ path }, std::runtime_error);
+}
+
+// Ensure that the scheduler runs every task exactly once, including tasks spawned by tasks
+TEST(UtilTest, WorkStealingScheduler)
+{
+	auto scheduler = WorkStealingScheduler{ 4 };
+	std::vector<std::atomic<int>> runs(100);
+
+	for (int k = 0; k < 10; k++) {
+		scheduler.spawn(k % 4, [&, k](int thread)
+			{
+				for (int i = 0; i < 10; i++)
+					scheduler.spawn(thread, [&runs, k, i](int) { runs[10 * k + i]++; });
+			});
+	}
+	scheduler.run();
+
+	for (const auto& count : runs)
+		EXPECT_EQ(1, count);
+
+	scheduler.spawn(1, [](int) { throw std::runtime_error("task failed"); });
+	EXPECT_THROW(scheduler.run(), std::runtime_error);
+}
+
+// Ensure that the thread pool runs every index of every loop exactly once and survives exceptions
+TEST(UtilTest, ThreadPool)
+{
+	auto pool = ThreadPool{ 3 };
+	EXPECT_EQ(3, pool.threads());
+
+	for (int loop = 0; loop < 50; loop++) {
+		std::vector<std::atomic<int>> runs(loop);
+		pool.parallelFor(runs.size(), [&runs](int thread, std::size_t i)
+			{
+				EXPECT_LE(0, thread);
+				EXPECT_GT(3, thread);
+				runs[i]++;
+			});
+
+		for (const auto& count : runs)
+			EXPECT_EQ(1, count);
+	}
+
+	const auto fail = [](int, std::size_t i)
+	{
+		if (7 == i)
+			throw std::runtime_error("item failed");
+	};
+	EXPECT_THROW(pool.parallelFor(20, fail), std::runtime_error);
+
+	std::atomic<int> sum = 0;
+	pool.parallelFor(10, [&sum](int, std::size_t i) { sum += static_cast<int>(i); });
+	EXPECT_EQ(45, sum);
+
+	// both items wait for each other, so two threads throw in the same loop
+	auto bothStarted = std::latch{ 2 };
+	const auto failTwice = [&bothStarted](int, std::size_t)
+	{
+		bothStarted.arrive_and_wait();
+		throw std::runtime_error("item failed");
+	};
+	EXPECT_THROW(pool.parallelFor(2, failTwice), std::runtime_error);
+	EXPECT_NO_THROW(pool.parallelFor(10, [](int, std::size_t) {}));
+}
@@ -4,7 +4,15 @@ module;
 #include <string>
 #include <cmath>
 #include <limits>
-#include <sstream>
+#include <string_view>
+#include <charconv>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <span>
 #include <numeric>
 #include <algorithm>
 #include <ranges>
@@ -22,6 +30,13 @@ Problem::Problem(std::size_t vertices, Value bigM)
         throw std::invalid_argument("A valid instance consists of at least 3 vertices.");
 }
 
+Problem::Problem(Value bigM, Value min, Value max, SparseEdgeTable<Value> lookup)
+    : vertices_(lookup.vertices()), big_m_(bigM), min_(min), max_(max), lookup_(std::move(lookup))
+{
+    if (vertices_ < 3)
+        throw std::invalid_argument("A valid instance consists of at least 3 vertices.");
+}
+
 std::size_t Problem::vertices() const noexcept
 {
     return vertices_;
@@ -53,10 +68,9 @@ void Problem::addEdge(Edge edge)
     if (edge.a == edge.b)
         throw std::invalid_argument(format("Looping edges (vertex {}) are forbidden.", edge.a));
 
-    if (big_m_ != lookup_.at(edge.a, edge.b))
+    if (!lookup_.insert(edge.a, edge.b, edge.value))
         throw std::invalid_argument(format("Duplicate edge ({} - {}).", edge.a, edge.b));
 
-    lookup_.at(edge.a, edge.b) = edge.value;
     min_ = std::min(min_, edge.value);
     max_ = std::max(max_, edge.value);
 }
@@ -69,51 +83,237 @@ Value Problem::value(Vertex start, Vertex end) const noexcept
     return lookup_.at(start, end);
 }
 
-Problem Problem::fromText(std::string text)
+std::span<const Vertex> Problem::neighbors(Vertex vertex) const noexcept
+{
+    return lookup_.neighbors(vertex);
+}
+
+std::span<const Value> Problem::neighborValues(Vertex vertex) const noexcept
+{
+    return lookup_.values(vertex);
+}
+
+/**
+ * Minimal forward-only number scanner over a text buffer.
+ * Numbers are separated by arbitrary whitespace, as with stream extraction.
+ */
+class TextScanner
+{
+
+public:
+
+    explicit TextScanner(std::string_view text) noexcept
+        : pos_(text.data()), end_(text.data() + text.size())
+    {
+    }
+
+    /**
+     * Read the next number from the text.
+     *
+     * @param out: destination for the parsed number
+     * @return: true on success, false if there is no well-formed number
+     */
+    template<typename T>
+    bool next(T& out) noexcept
+    {
+        while (pos_ != end_ && std::isspace(static_cast<unsigned char>(*pos_)))
+            ++pos_;
+
+        const auto [ptr, ec] = std::from_chars(pos_, end_, out);
+        pos_ = ptr;
+        return std::errc{} == ec;
+    }
+
+private:
+
+    const char* pos_;
+    const char* end_;
+
+};
+
+Problem Problem::fromText(std::string_view text)
 {
-    auto stream = std::istringstream{ text };
+    auto scanner = TextScanner{ text };
 
     std::size_t vertices = 0;
     std::size_t edges = 0;
 
-    if (stream) stream >> vertices;
-    if (stream) stream >> edges;
-
-    if (!stream)
+    if (!scanner.next(vertices) || !scanner.next(edges))
         throw std::runtime_error("An instance must specify the number of vertices and edges.");
 
     std::vector<Edge> edgeList;
+    edgeList.reserve(edges);
 
     for (std::size_t i = 0; i < edges; i++) {
-        Vertex a; // first node in the edge
-        Vertex b; // second node in the edge
+        std::int64_t a; // first node in the edge
+        std::int64_t b; // second node in the edge
         Value value; // value added to the solution that contains this edge
 
-        if (stream) stream >> a;
-        if (stream) stream >> b;
-        if (stream) stream >> value;
-
-        if (!stream)
+        if (!scanner.next(a) || !scanner.next(b) || !scanner.next(value))
             throw std::runtime_error(format("Failed to read edge {}.", i));
 
-        if (a >= vertices)
+        if (a < 0 || static_cast<std::size_t>(a) >= vertices)
             throw std::out_of_range(format("From-vertex in edge {} is out of range: {} (>= {}).", i, a, vertices));
 
-        if (b >= vertices)
+        if (b < 0 || static_cast<std::size_t>(b) >= vertices)
             throw std::out_of_range(format("To-vertex in edge {} is out of range: {} (>= {}).", i, b, vertices));
 
-        edgeList.push_back({ a, b, value });
+        if (a == b)
+            throw std::invalid_argument(format("Looping edges (vertex {}) are forbidden.", a));
+
+        edgeList.push_back({ static_cast<Vertex>(a), static_cast<Vertex>(b), value });
     }
 
     const Value bigM = calculateBigM(vertices, edgeList);
     auto problem = Problem{ vertices, bigM };
 
-    for (const Edge& e : edgeList)
-        problem.addEdge(e);
+    // bulk-build the sparse table instead of inserting edge by edge
+    problem.lookup_ = SparseEdgeTable<Value>::fromEdges(vertices, bigM, edgeList);
+
+    for (const Edge& e : edgeList) {
+        problem.min_ = std::min(problem.min_, e.value);
+        problem.max_ = std::max(problem.max_, e.value);
+    }
 
     return problem;
 }
 
+/**
+ * Header of the binary Problem format.
+ *
+ * The header is followed by the edge table arrays: the row offsets, the
+ * neighbor vertices (padded to a multiple of 8 bytes) and the edge values.
+ * All fields are in native byte order.
+ */
+struct BinaryHeader
+{
+    char magic[8]; //!< file format identifier
+    std::uint32_t version; //!< file format version
+    std::uint32_t reserved; //!< zero
+    std::uint64_t vertices; //!< number of vertices in the instance
+    std::uint64_t entries; //!< number of neighbor entries, i.e. twice the number of edges
+    std::int64_t bigM; //!< value of unspecified edges
+    std::int64_t min; //!< minimum value of any edge
+    std::int64_t max; //!< maximum value of any edge
+    std::uint64_t checksum; //!< checksum over the header with this field zeroed and the data following it
+};
+
+static_assert(sizeof(BinaryHeader) == 64);
+
+constexpr char binaryMagic[8] = { 'C', 'B', 'T', 'S', 'P', 'B', 'I', 'N' };
+constexpr std::uint32_t binaryVersion = 2;
+
+/**
+ * Determine the number of 64-bit words in the binary Problem data after the header.
+ */
+std::size_t binaryWords(std::uint64_t vertices, std::uint64_t entries) noexcept
+{
+    return (vertices + 1) + (entries + 1) / 2 + entries;
+}
+
+/**
+ * Calculate the checksum over the binary header and data, word by word with FNV-1a.
+ * The checksum field of the header counts as zero.
+ */
+std::uint64_t binaryChecksum(const BinaryHeader& header, std::span<const std::uint64_t> words) noexcept
+{
+    std::uint64_t headerWords[sizeof header / sizeof(std::uint64_t)];
+    std::memcpy(headerWords, &header, sizeof header);
+    headerWords[offsetof(BinaryHeader, checksum) / sizeof(std::uint64_t)] = 0;
+
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+    for (const std::uint64_t word : headerWords)
+        hash = (hash ^ word) * 0x100000001b3ull;
+    for (const std::uint64_t word : words)
+        hash = (hash ^ word) * 0x100000001b3ull;
+    return hash;
+}
+
+bool Problem::isBinary(std::string_view data) noexcept
+{
+    return data.starts_with(std::string_view{ binaryMagic, sizeof binaryMagic });
+}
+
+Problem Problem::fromBinary(std::shared_ptr<const MappedFile> file)
+{
+    const auto data = file->view();
+    BinaryHeader header;
+
+    if (data.size() < sizeof header || !isBinary(data))
+        throw std::runtime_error("Not a binary instance.");
+
+    std::memcpy(&header, data.data(), sizeof header);
+
+    if (binaryVersion != header.version)
+        throw std::runtime_error(format("Unsupported binary instance version {} (expected {}).", header.version, binaryVersion));
+
+    // bound the counts before the size calculation, which could overflow otherwise
+    if (header.vertices > std::numeric_limits<Vertex>::max() || header.entries > data.size() / sizeof(Value))
+        throw std::runtime_error("Binary instance size does not match its header.");
+
+    const auto words = binaryWords(header.vertices, header.entries);
+    if (data.size() != sizeof header + words * sizeof(std::uint64_t))
+        throw std::runtime_error("Binary instance size does not match its header.");
+
+    // the mapping is page-aligned and the header size is a multiple of 8
+    const auto payload = reinterpret_cast<const std::uint64_t*>(data.data() + sizeof header);
+    if (header.checksum != binaryChecksum(header, { payload, words }))
+        throw std::runtime_error("Binary instance checksum mismatch.");
+
+    const auto offsets = payload;
+    const auto neighbors = reinterpret_cast<const Vertex*>(offsets + header.vertices + 1);
+    const auto values = reinterpret_cast<const Value*>(offsets + header.vertices + 1 + (header.entries + 1) / 2);
+
+    const auto inconsistent = std::runtime_error("Binary instance edge table is inconsistent.");
+
+    if (0 != offsets[0] || offsets[header.vertices] != header.entries)
+        throw inconsistent;
+
+    for (std::uint64_t v = 0; v < header.vertices; v++) {
+        if (offsets[v] > offsets[v + 1])
+            throw inconsistent;
+    }
+
+    for (std::uint64_t i = 0; i < header.entries; i++) {
+        if (neighbors[i] >= header.vertices)
+            throw inconsistent;
+    }
+
+    auto lookup = SparseEdgeTable<Value>::fromStorage(header.vertices, header.bigM,
+        offsets, neighbors, values, std::move(file));
+    return Problem{ header.bigM, header.min, header.max, std::move(lookup) };
+}
+
+void Problem::writeBinary(std::ostream& stream) const
+{
+    static_assert(sizeof(Vertex) * 2 == sizeof(std::uint64_t));
+
+    const auto offsets = lookup_.storageOffsets();
+    const auto neighbors = lookup_.storageNeighbors();
+    const auto values = lookup_.storageValues();
+    const std::uint64_t entries = neighbors.size();
+
+    auto payload = std::vector<std::uint64_t>(binaryWords(vertices_, entries), 0);
+    std::ranges::copy(offsets, payload.begin());
+    auto out = reinterpret_cast<char*>(payload.data() + offsets.size());
+    std::memcpy(out, neighbors.data(), neighbors.size_bytes());
+    out += (entries + 1) / 2 * sizeof(std::uint64_t);
+    std::memcpy(out, values.data(), values.size_bytes());
+
+    BinaryHeader header{};
+    std::memcpy(header.magic, binaryMagic, sizeof binaryMagic);
+    header.version = binaryVersion;
+    header.vertices = vertices_;
+    header.entries = entries;
+    header.bigM = big_m_;
+    header.min = min_;
+    header.max = max_;
+    header.checksum = binaryChecksum(header, payload);
+
+    stream.write(reinterpret_cast<const char*>(&header), sizeof header);
+    stream.write(reinterpret_cast<const char*>(payload.data()), payload.size() * sizeof(std::uint64_t));
+}
+
 Value Problem::calculateBigM(std::size_t vertices, const std::vector<Edge>& edges)
 {
     // There must be enough edges in the problem, otherwise we simply refuse to compute
@@ -141,20 +341,22 @@ Value Problem::calculateBigM(std::size_t vertices, const std::vector<Edge>& edge
 }
 
 Solution::Solution(const Problem& problem, std::vector<Vertex>&& vertices)
-    : problem_(&problem), vertices_(vertices)
+    : problem_(&problem), vertices_(vertices), layout_(TourLayout::ARRAY), stale_(false)
 {
     vertices_.reserve(problem_->vertices());
     value_ = calculateValue();
 }
 
 Solution::Solution(const Problem& problem, std::vector<Vertex>&& vertices, Value value)
-    : problem_(&problem), vertices_(vertices), value_(value)
+    : problem_(&problem), vertices_(vertices), value_(value), layout_(TourLayout::ARRAY), stale_(false)
 {
     vertices_.reserve(problem_->vertices());
 }
 
 std::string Solution::representation() const
 {
+    sync();
+
     if (vertices_.empty())
         return {};
 
@@ -169,11 +371,23 @@ std::string Solution::representation() const
         std::to_string(vertices_.front()), appendVertex);
 }
 
-const std::vector<Vertex>& Solution::vertices() const noexcept
+const Problem& Solution::problem() const noexcept
 {
+    return *problem_;
+}
+
+const std::vector<Vertex>& Solution::vertices() const
+{
+    sync();
     return vertices_;
 }
 
+Vertex Solution::vertexAt(std::size_t pos) const noexcept
+{
+    assert(pos < vertices_.size());
+    return stale_ ? tour_->at(pos) : vertices_[pos];
+}
+
 Value Solution::value() const noexcept
 {
     return value_;
@@ -199,13 +413,15 @@ bool Solution::isPartial() const noexcept
     return vertices_.size() < problem_->vertices();
 }
 
-bool Solution::isFeasible() const noexcept
+bool Solution::isFeasible() const
 {
     return !isPartial() && 0 == countInfeasibleEdges();
 }
 
-int Solution::countInfeasibleEdges() const noexcept
+int Solution::countInfeasibleEdges() const
 {
+    sync();
+
     if (vertices_.empty())
         return 0;
 
@@ -225,6 +441,7 @@ int Solution::countInfeasibleEdges() const noexcept
 void Solution::insert(std::size_t pos, Vertex vertex)
 {
     assert(pos <= vertices_.size());
+    sync();
 
     // delta-update solution value
     const std::size_t n = vertices_.size();
@@ -238,6 +455,9 @@ void Solution::insert(std::size_t pos, Vertex vertex)
     }
 
     vertices_.insert(vertices_.begin() + pos, vertex);
+
+    if (TourLayout::TWO_LEVEL == layout_)
+        tour_.emplace(vertices_);
 }
 
 Value Solution::twoOptValue(std::size_t v1, std::size_t v2) const
@@ -253,10 +473,10 @@ Value Solution::twoOptValue(std::size_t v1, std::size_t v2) const
 
     // compute new value by delta-evaluation
     const std::size_t n = vertices_.size();
-    Vertex prev1 = vertices_[(low + n - 1) % n];
-    Vertex next1 = vertices_[low];
-    Vertex prev2 = vertices_[(high + n - 1) % n];
-    Vertex next2 = vertices_[high];
+    Vertex prev1 = vertexAt((low + n - 1) % n);
+    Vertex next1 = vertexAt(low);
+    Vertex prev2 = vertexAt((high + n - 1) % n);
+    Vertex next2 = vertexAt(high);
     return value_ + problem_->value(prev1, prev2) + problem_->value(next1, next2)
         - problem_->value(prev1, next1) - problem_->value(prev2, next2);
 }
@@ -269,7 +489,35 @@ void Solution::twoOpt(std::size_t v1, std::size_t v2)
     auto [low, high] = std::minmax(v1, v2);
 
     value_ = twoOptValue(v1, v2);
-    std::reverse(vertices_.begin() + low, vertices_.begin() + high);
+
+    if (TourLayout::TWO_LEVEL == layout_) {
+        tour_->reverse(low, high);
+        stale_ = true;
+    }
+    else {
+        std::reverse(vertices_.begin() + low, vertices_.begin() + high);
+    }
+}
+
+TourLayout Solution::layout() const noexcept
+{
+    return layout_;
+}
+
+void Solution::setLayout(TourLayout layout)
+{
+    if (layout == layout_)
+        return;
+
+    if (TourLayout::TWO_LEVEL == layout) {
+        tour_.emplace(vertices_);
+    }
+    else {
+        sync();
+        tour_.reset();
+    }
+
+    layout_ = layout;
 }
 
 void Solution::normalize()
@@ -278,6 +526,8 @@ void Solution::normalize()
     if (n < 2)
         return; // single-vertex solutions are always normal
 
+    sync();
+
     const auto begin = vertices_.begin();
     const auto end = vertices_.end();
     std::size_t start = std::min_element(begin, end) - begin;
@@ -293,6 +543,17 @@ void Solution::normalize()
     else {
         std::rotate(begin, begin + start, end);
     }
+
+    if (TourLayout::TWO_LEVEL == layout_)
+        tour_.emplace(vertices_);
+}
+
+void Solution::sync() const
+{
+    if (stale_) {
+        tour_->copyTo(vertices_);
+        stale_ = false;
+    }
 }
 
 Value Solution::calculateValue()
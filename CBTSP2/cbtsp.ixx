@@ -4,14 +4,24 @@
 module;
 
 #include <string>
+#include <string_view>
+#include <iosfwd>
 #include <cstdint>
 #include <vector>
+#include <memory>
+#include <optional>
 #include <random>
 #include <algorithm>
+#include <numeric>
+#include <ranges>
+#include <span>
+#include <stdexcept>
 #include <cassert>
 
 export module cbtsp;
 
+import util;
+
 export using Vertex = unsigned int; //!< type for graph nodes
 export using Value = std::int64_t; //!< type for graph edges
 export using Random = std::default_random_engine; //!< global type of random number generator
@@ -93,7 +103,8 @@ private:
     {
         const auto [lo, hi] = std::minmax(a, b);
         assert(lo < hi);
-        auto result = (hi * hi - hi) / 2 + lo;
+        const std::size_t wide = hi; // hi * hi overflows Vertex in large graphs
+        auto result = (wide * wide - wide) / 2 + lo;
         assert(result < values_.size());
         return result;
     }
@@ -110,6 +121,315 @@ export struct Edge
     Value value; //!< value added to the solution that contains this edge
 };
 
+/**
+ * Sparse edge attribute container for our undirected, no-loop graph.
+ * Only explicitly inserted edges occupy storage. All other edges have the default value.
+ *
+ * The edges are stored in compressed sparse row (CSR) form: the neighbors of
+ * every vertex lie contiguously in one array, sorted by vertex number, and
+ * their edge values lie at the same positions in a parallel array.
+ * Every edge is stored in the rows of both endpoints, so that each row
+ * lists the complete neighborhood of its vertex.
+ *
+ * The arrays are immutable and shared among copies of the table. They are
+ * either owned by the table or provided by external storage, such as a
+ * memory-mapped file. Insertion replaces them with a modified copy.
+ */
+export template<typename T> class SparseEdgeTable
+{
+
+public:
+
+    /**
+     * Construct the table for the given number of vertices in the graph
+     * and with the given value for unspecified edges.
+     *
+     * @param vertices: number of vertices in the graph
+     * @param init: value of edges which are not in the table
+     */
+    explicit SparseEdgeTable(std::size_t vertices, T init)
+        : init_(init), vertices_(vertices)
+    {
+        adopt({ std::vector<std::uint64_t>(vertices + 1, 0), {}, {} });
+    }
+
+    /**
+     * Construct the table from a complete list of edges in one pass.
+     *
+     * The edges must be objects with members `a`, `b` and `value`.
+     * Their endpoints must be distinct and in range.
+     *
+     * @param vertices: number of vertices in the graph
+     * @param init: value of edges which are not in the table
+     * @param edges: range of all edges in the graph
+     * @return: the filled table
+     * @throw std::invalid_argument: if the list contains duplicate edges
+     */
+    template<std::ranges::forward_range Edges>
+    static SparseEdgeTable fromEdges(std::size_t vertices, T init, const Edges& edges)
+    {
+        auto arrays = Arrays{ std::vector<std::uint64_t>(vertices + 1, 0), {}, {} };
+        auto& offsets = arrays.offsets;
+
+        for (const auto& e : edges) {
+            assert(e.a != e.b);
+            offsets[e.a + 1]++;
+            offsets[e.b + 1]++;
+        }
+
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+        // fill rows in edge order, then sort each row
+        auto unsorted = std::vector<std::pair<Vertex, T>>(offsets.back());
+        auto fill = std::vector<std::uint64_t>(offsets.begin(), offsets.end() - 1);
+
+        for (const auto& e : edges) {
+            unsorted[fill[e.a]++] = { static_cast<Vertex>(e.b), static_cast<T>(e.value) };
+            unsorted[fill[e.b]++] = { static_cast<Vertex>(e.a), static_cast<T>(e.value) };
+        }
+
+        arrays.targets.reserve(unsorted.size());
+        arrays.values.reserve(unsorted.size());
+
+        for (std::size_t v = 0; v < vertices; v++) {
+            const auto row = std::span{ unsorted.data() + offsets[v], offsets[v + 1] - offsets[v] };
+            std::ranges::sort(row, {}, &std::pair<Vertex, T>::first);
+
+            const auto duplicate = std::ranges::adjacent_find(row, {}, &std::pair<Vertex, T>::first);
+            if (duplicate != row.end())
+                throw std::invalid_argument(format("Duplicate edge ({} - {}).", v, duplicate->first));
+
+            for (const auto& [target, value] : row) {
+                arrays.targets.push_back(target);
+                arrays.values.push_back(value);
+            }
+        }
+
+        auto table = SparseEdgeTable{};
+        table.init_ = init;
+        table.vertices_ = vertices;
+        table.adopt(std::move(arrays));
+        return table;
+    }
+
+    /**
+     * Construct the table as a view of CSR arrays in external storage.
+     *
+     * The arrays must have the layout of `storageOffsets()`, `storageNeighbors()`
+     * and `storageValues()`. They are not copied.
+     *
+     * @param vertices: number of vertices in the graph
+     * @param init: value of edges which are not in the table
+     * @param offsets: start of every vertex row, plus end marker
+     * @param neighbors: all rows of adjacent vertices
+     * @param values: edge values parallel to neighbors
+     * @param storage: owner of the arrays, kept alive for as long as the table needs them
+     * @return: the table
+     */
+    static SparseEdgeTable fromStorage(std::size_t vertices, T init,
+        const std::uint64_t* offsets, const Vertex* neighbors, const T* values,
+        std::shared_ptr<const void> storage) noexcept
+    {
+        auto table = SparseEdgeTable{};
+        table.init_ = init;
+        table.vertices_ = vertices;
+        table.storage_ = std::move(storage);
+        table.offsets_ = offsets;
+        table.targets_ = neighbors;
+        table.values_ = values;
+        return table;
+    }
+
+    /**
+     * Get the number of vertices in the graph.
+     */
+    std::size_t vertices() const noexcept
+    {
+        return vertices_;
+    }
+
+    /**
+     * Determine whether the edge from a to b is stored in the table.
+     *
+     * @param a: first edge endpoint
+     * @param b: second edge endpoint
+     * @return: true if the edge {a, b} has an explicit value, false otherwise
+     */
+    bool contains(Vertex a, Vertex b) const noexcept
+    {
+        return npos != find(a, b);
+    }
+
+    /**
+     * Look up the edge value from a to b.
+     *
+     * @param a: first edge endpoint
+     * @param b: second edge endpoint
+     * @return: value of the edge {a, b}, or the default value if it is not stored
+     */
+    T at(Vertex a, Vertex b) const noexcept
+    {
+        const auto index = find(a, b);
+        return npos != index ? values_[index] : init_;
+    }
+
+    /**
+     * Get the neighbors of the given vertex, sorted by vertex number.
+     *
+     * @param v: vertex
+     * @return: view of the adjacent vertices of v
+     */
+    std::span<const Vertex> neighbors(Vertex v) const noexcept
+    {
+        assert(v < vertices_);
+        return { targets_ + offsets_[v], targets_ + offsets_[v + 1] };
+    }
+
+    /**
+     * Get the values of the edges to the neighbors of the given vertex.
+     * The values are in the same order as the result of `neighbors(v)`.
+     *
+     * @param v: vertex
+     * @return: view of the edge values of v
+     */
+    std::span<const T> values(Vertex v) const noexcept
+    {
+        assert(v < vertices_);
+        return { values_ + offsets_[v], values_ + offsets_[v + 1] };
+    }
+
+    /**
+     * Access the complete row offset array: the start of every vertex row, plus end marker.
+     */
+    std::span<const std::uint64_t> storageOffsets() const noexcept
+    {
+        return { offsets_, vertices_ + 1 };
+    }
+
+    /**
+     * Access the complete array of adjacent vertices, all rows in sequence.
+     */
+    std::span<const Vertex> storageNeighbors() const noexcept
+    {
+        return { targets_, offsets_[vertices_] };
+    }
+
+    /**
+     * Access the complete array of edge values, parallel to `storageNeighbors()`.
+     */
+    std::span<const T> storageValues() const noexcept
+    {
+        return { values_, offsets_[vertices_] };
+    }
+
+    /**
+     * Add a new edge with the given value to the table.
+     *
+     * This is an O(edges) operation which is intended for small graphs
+     * and for building graphs edge by edge. To build a large graph,
+     * use `fromEdges`.
+     *
+     * @param a: first edge endpoint
+     * @param b: second edge endpoint
+     * @param value: edge value
+     * @return: true if the edge was added, false if it already existed
+     */
+    bool insert(Vertex a, Vertex b, T value)
+    {
+        assert(a != b);
+
+        if (contains(a, b))
+            return false;
+
+        auto arrays = Arrays{
+            { storageOffsets().begin(), storageOffsets().end() },
+            { storageNeighbors().begin(), storageNeighbors().end() },
+            { storageValues().begin(), storageValues().end() } };
+        insertHalf(arrays, a, b, value);
+        insertHalf(arrays, b, a, value);
+        adopt(std::move(arrays));
+        return true;
+    }
+
+private:
+
+    /**
+     * Storage for the CSR arrays which are owned by the table.
+     */
+    struct Arrays
+    {
+        std::vector<std::uint64_t> offsets; //!< start of every vertex row, plus end marker
+        std::vector<Vertex> targets; //!< all rows of adjacent vertices
+        std::vector<T> values; //!< edge values parallel to targets
+    };
+
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1); //!< index of absent edges
+
+    T init_ = {}; //!< value of edges which are not stored
+    std::size_t vertices_ = 0; //!< number of vertices in the graph
+    std::shared_ptr<const void> storage_; //!< owner of the arrays, shared among copies
+    const std::uint64_t* offsets_ = nullptr; //!< start of every vertex row, plus end marker
+    const Vertex* targets_ = nullptr; //!< all rows of adjacent vertices
+    const T* values_ = nullptr; //!< edge values parallel to targets_
+
+    //! Construct the table without any storage.
+    SparseEdgeTable() noexcept = default;
+
+    /**
+     * Take ownership of the given arrays and use them as the table storage.
+     */
+    void adopt(Arrays&& arrays)
+    {
+        auto owned = std::make_shared<const Arrays>(std::move(arrays));
+        offsets_ = owned->offsets.data();
+        targets_ = owned->targets.data();
+        values_ = owned->values.data();
+        storage_ = std::move(owned);
+    }
+
+    /**
+     * Find the storage index of the edge from a to b.
+     *
+     * This is a branchless binary search for the last entry not greater than b.
+     * The rows of real instances are short, so it mostly touches a single cache line.
+     */
+    std::size_t find(Vertex a, Vertex b) const noexcept
+    {
+        assert(a != b);
+
+        const auto row = neighbors(a);
+        const Vertex* base = row.data();
+        std::size_t length = row.size();
+
+        if (0 == length)
+            return npos;
+
+        while (length > 1) {
+            const auto half = length / 2;
+            base = (base[half] <= b) ? base + half : base;
+            length -= half;
+        }
+
+        return *base == b ? base - targets_ : npos;
+    }
+
+    /**
+     * Insert the entry for `to` into the row of `from` in the given arrays, maintaining order.
+     */
+    static void insertHalf(Arrays& arrays, Vertex from, Vertex to, T value)
+    {
+        const auto begin = arrays.targets.begin() + arrays.offsets[from];
+        const auto end = arrays.targets.begin() + arrays.offsets[from + 1];
+        const auto pos = std::lower_bound(begin, end, to) - arrays.targets.begin();
+        arrays.targets.insert(arrays.targets.begin() + pos, to);
+        arrays.values.insert(arrays.values.begin() + pos, value);
+
+        for (std::size_t v = from + 1; v < arrays.offsets.size(); v++)
+            arrays.offsets[v]++;
+    }
+
+};
+
 /**
  * Represents an instance of the Cost - Balanced Traveling Salesperson Problem.
  *
@@ -169,16 +489,71 @@ public:
      */
     Value value(Vertex start, Vertex end) const noexcept;
 
+    /**
+     * Get the vertices which are connected to the given vertex by explicitly specified edges.
+     *
+     * @param vertex: vertex in the instance
+     * @return: all neighbors of the vertex along real (non-big-M) edges, sorted by vertex number
+     */
+    std::span<const Vertex> neighbors(Vertex vertex) const noexcept;
+
+    /**
+     * Get the values of the explicitly specified edges which are incident to the given vertex.
+     *
+     * @param vertex: vertex in the instance
+     * @return: values of the edges to `neighbors(vertex)`, in the same order
+     */
+    std::span<const Value> neighborValues(Vertex vertex) const noexcept;
+
     /**
      * Parse the given text into an Instance.
      *
+     * The text is parsed in a single pass without copying it, so it can
+     * come straight from a memory-mapped file.
+     *
      * @param text: String which conforms to the syntax specified by the exercise assignment
      * @return: the Problem
      */
-    static Problem fromText(std::string text);
+    static Problem fromText(std::string_view text);
+
+    /**
+     * Determine whether the given data starts like a Problem in binary format.
+     *
+     * @param data: file contents
+     * @return: true if the data should be read with `fromBinary`, false otherwise
+     */
+    static bool isBinary(std::string_view data) noexcept;
+
+    /**
+     * Use the contents of the given file, which must be in binary format, as a Problem.
+     *
+     * The edge table is used in place, without deserialization. The Problem
+     * keeps the file mapped for as long as it or any of its copies exist.
+     *
+     * @param file: mapped binary problem file
+     * @return: the Problem
+     * @throw std::runtime_error: if the file is malformed or corrupted
+     */
+    static Problem fromBinary(std::shared_ptr<const MappedFile> file);
+
+    /**
+     * Write the Problem to the given stream in binary format.
+     *
+     * The binary format consists of a header with format version, instance
+     * parameters and a checksum, followed by the edge table arrays.
+     * It does not need to be parsed and its big-M is pre-calculated.
+     *
+     * @param stream: binary output stream
+     */
+    void writeBinary(std::ostream& stream) const;
 
 private:
 
+    /**
+     * Construct a Problem from its completely computed parts.
+     */
+    explicit Problem(Value bigM, Value min, Value max, SparseEdgeTable<Value> lookup);
+
     /**
      * Calculate the big-M value for unspecified edges from the proposed edge list.
      */
@@ -188,14 +563,145 @@ private:
     Value big_m_; //!< value which is returned for edges between vertices that are not connected
     Value min_; //!< minimum value of any edge
     Value max_; //!< maximum value of any edge
-    EdgeTable<Value> lookup_; //!< table of edge values
+    SparseEdgeTable<Value> lookup_; //!< table of edge values, big-M for unspecified edges
 
 };
 
+/**
+ * Tour representation with sub-linear segment reversal.
+ *
+ * The tour is divided into about sqrt(n) segments, which are kept in a list
+ * in tour order. Each segment is a contiguous range of vertex slots with a
+ * reversal bit. The vertices never move between slots except on rebuild.
+ * Reversing a part of the tour splits at most two segments, then reverses
+ * the order of the segments in-between and flips their reversal bits.
+ *
+ * Reversal costs amortized O(sqrt(n)). Vertex positions, successors,
+ * predecessors and betweenness are O(1). Access by position is O(log n).
+ */
+export class TwoLevelTour
+{
+
+public:
+
+    /**
+     * Construct the tour with the given vertex sequence.
+     *
+     * @param vertices: tour vertices in order, every vertex in [0, n) exactly once
+     */
+    explicit TwoLevelTour(const std::vector<Vertex>& vertices);
+
+    /**
+     * Get the number of vertices in the tour.
+     */
+    std::size_t size() const noexcept;
+
+    /**
+     * Get the vertex at the given position in the tour.
+     */
+    Vertex at(std::size_t pos) const noexcept;
+
+    /**
+     * Get the position of the given vertex in the tour.
+     */
+    std::size_t position(Vertex vertex) const noexcept;
+
+    /**
+     * Get the vertex which follows the given vertex in the tour, cyclically.
+     */
+    Vertex next(Vertex vertex) const noexcept;
+
+    /**
+     * Get the vertex which precedes the given vertex in the tour, cyclically.
+     */
+    Vertex prev(Vertex vertex) const noexcept;
+
+    /**
+     * Determine whether b lies on the way from a forward to c in the tour.
+     *
+     * @return: true if b is visited after a and before c (inclusive), cyclically
+     */
+    bool between(Vertex a, Vertex b, Vertex c) const noexcept;
+
+    /**
+     * Reverse the order of the vertices at the positions [low, high).
+     *
+     * @param low: position of the first vertex to reverse
+     * @param high: position after the last vertex to reverse
+     */
+    void reverse(std::size_t low, std::size_t high);
+
+    /**
+     * Produce the vertex sequence of the tour.
+     *
+     * @param sequence: destination for the tour vertices in order
+     */
+    void copyTo(std::vector<Vertex>& sequence) const;
+
+private:
+
+    /**
+     * A part of the tour whose vertices lie in the slots [begin, end).
+     */
+    struct Segment
+    {
+        std::size_t begin; //!< first slot of the segment
+        std::size_t end; //!< past-end slot of the segment
+        std::size_t rank; //!< index of the segment in the tour order
+        bool reversed; //!< whether the tour visits the slots from end to begin
+    };
+
+    std::vector<Vertex> slots_; //!< storage for all vertices, in segment runs
+    std::vector<std::size_t> slotOf_; //!< slot of every vertex
+    std::vector<std::size_t> segmentOf_; //!< segment of every vertex
+    std::vector<Segment> segments_; //!< all segments, in order of creation
+    std::vector<std::size_t> order_; //!< segments in tour order
+    std::vector<std::size_t> starts_; //!< tour position of the first vertex in each segment, by rank
+    std::size_t idealSize_; //!< segment size after rebuild
+    std::vector<Vertex> scratch_; //!< reusable sequence buffer for rebuilds
+
+    /**
+     * Redistribute the given tour into uniform segments.
+     */
+    void rebuild(const std::vector<Vertex>& vertices);
+
+    /**
+     * Ensure that a segment begins at the given position.
+     *
+     * @return: the rank of the segment which begins at the position
+     */
+    std::size_t splitAt(std::size_t pos);
+
+    /**
+     * Get the offset of the given slot in tour order relative to its segment.
+     */
+    static std::size_t offsetOf(const Segment& segment, std::size_t slot) noexcept;
+
+    /**
+     * Get the slot at the given offset in tour order relative to the segment.
+     */
+    static std::size_t slotAt(const Segment& segment, std::size_t offset) noexcept;
+
+};
+
+/**
+ * Available data structures for the vertex sequence of a Solution.
+ */
+export enum class TourLayout
+{
+    ARRAY, //!< plain vertex array: fastest access, O(n) two-opt moves
+    TWO_LEVEL //!< two-level segment list: O(log n) access, O(sqrt(n)) two-opt moves
+};
+
 /**
  * Represents a (full or partial) solution to the Cost-Balanced Traveling Salesperson Problem.
  *
  * A solution is a list of vertices to visit in a CBTSP Instance in that order.
+ *
+ * With the TWO_LEVEL layout, the vertex vector is brought up to date lazily by
+ * `vertices()`, `representation()` and `countInfeasibleEdges()`, so these const
+ * functions may write to the solution. A solution which is read by several threads
+ * at once must first be brought up to date on one thread, for example by `vertices()`.
  */
 export class Solution
 {
@@ -223,12 +729,27 @@ public:
      */
     std::string representation() const;
 
+    /**
+     * Get the problem instance which this solution belongs to.
+     */
+    const Problem& problem() const noexcept;
+
     /**
      * Get the vector which stores the solution tour.
+     * This brings the vector up to date with the TWO_LEVEL layout, which allocates.
      *
      * @return: stored tour
      */
-    const std::vector<Vertex>& vertices() const noexcept;
+    const std::vector<Vertex>& vertices() const;
+
+    /**
+     * Get the vertex at the given position in the solution tour.
+     * Unlike `vertices()`, this does not need to bring the vertex vector up to date.
+     *
+     * @param pos: index in the tour
+     * @return: vertex number
+     */
+    Vertex vertexAt(std::size_t pos) const noexcept;
 
     /**
      * Get the tour value of this solution.
@@ -269,14 +790,14 @@ public:
      *
      * @return: true if the Solution is feasible, false otherwise
      */
-    bool isFeasible() const noexcept;
+    bool isFeasible() const;
 
     /**
      * Get the number of edges in the Solution which have big-M value in the problem.
      *
      * @return: the number of infeasible edges
      */
-    int countInfeasibleEdges() const noexcept;
+    int countInfeasibleEdges() const;
 
     /**
      * Extend the solution by including an additional vertex at the specified position.
@@ -302,6 +823,21 @@ public:
      */
     void twoOpt(std::size_t v1, std::size_t v2);
 
+    /**
+     * Get the data structure which currently stores the tour.
+     */
+    TourLayout layout() const noexcept;
+
+    /**
+     * Switch the data structure which stores the tour.
+     *
+     * The TWO_LEVEL layout makes two-opt moves cheap on large tours.
+     * Its vertex vector is only brought up to date when requested.
+     *
+     * @param layout: the new tour layout
+     */
+    void setLayout(TourLayout layout);
+
     /**
      * Change this solution into its normalized variant.
      *
@@ -317,8 +853,16 @@ public:
 private:
 
     const Problem* problem_;
-    std::vector<Vertex> vertices_;
+    mutable std::vector<Vertex> vertices_; //!< tour sequence, outdated while stale_
     Value value_;
+    TourLayout layout_; //!< which data structure stores the tour
+    std::optional<TwoLevelTour> tour_; //!< tour storage for the TWO_LEVEL layout
+    mutable bool stale_; //!< whether vertices_ misses moves that were applied to tour_
+
+    /**
+     * Bring the vertex vector up to date with the two-level tour.
+     */
+    void sync() const;
 
     /**
      * Return the value of the solution.
@@ -5,10 +5,13 @@ module;
 #include <functional>
 #include <filesystem>
 #include <cassert>
+#include <cstdint>
 
 module config;
 
 import util;
+import cbtsp;
+import local;
 import mco;
 
 /**
@@ -48,10 +51,10 @@ struct Parser
     enum class Token
     {
         LITERAL,
-        SUITE, ALGORITHM, STEP,
+        SUITE, ALGORITHM, STEP, TOUR, DONT_LOOK, DELTA_CACHE, DELTA_INDEX,
         ITERATIONS, POPSIZE, EVAPORATION, ELITISM, MIN_PHEROMONE, MAX_PHEROMONE,
         PHEROMONE_ATTRACTION, OBJECTIVE_ATTRACTION, INTENSIFICATION, REINFORCE_STRATEGY,
-        RUNS, STATS_OUT, OPT_END
+        CANDIDATES, RUNS, THREADS, SEARCH_THREADS, BATCH, SEED, STATS_OUT, COMPILE_INSTANCE, OPT_END
     };
 
     /**
@@ -67,6 +70,10 @@ struct Parser
         if ("--suite"s == opt)                      return Token::SUITE;
         if ("-a"s == opt || "--algorithm"s == opt)  return Token::ALGORITHM;
         if ("-s"s == opt || "--step"s == opt)       return Token::STEP;
+        if ("--tour"s == opt)                       return Token::TOUR;
+        if ("--dont-look"s == opt)                  return Token::DONT_LOOK;
+        if ("--delta-cache"s == opt)                return Token::DELTA_CACHE;
+        if ("--delta-index"s == opt)                return Token::DELTA_INDEX;
         if ("-i"s == opt || "--iterations"s == opt) return Token::ITERATIONS;
         if ("-p"s == opt || "--popsize"s == opt)    return Token::POPSIZE;
         if ("--evaporation"s == opt)                return Token::EVAPORATION;
@@ -77,8 +84,14 @@ struct Parser
         if ("--objective-attraction"s == opt)       return Token::OBJECTIVE_ATTRACTION;
         if ("--intensification"s == opt)            return Token::INTENSIFICATION;
         if ("--reinforce-strategy"s == opt)         return Token::REINFORCE_STRATEGY;
+        if ("--candidates"s == opt)                 return Token::CANDIDATES;
         if ("-r"s == opt || "--runs"s == opt)       return Token::RUNS;
+        if ("-t"s == opt || "--threads"s == opt)    return Token::THREADS;
+        if ("--search-threads"s == opt)             return Token::SEARCH_THREADS;
+        if ("--batch"s == opt)                      return Token::BATCH;
+        if ("--seed"s == opt)                       return Token::SEED;
         if ("-d"s == opt || "--dump"s == opt)       return Token::STATS_OUT;
+        if ("--compile-instance"s == opt)           return Token::COMPILE_INSTANCE;
         if ("--"s == opt)                           return Token::OPT_END;
 
         return Token::LITERAL;
@@ -99,6 +112,12 @@ struct Parser
         if ("single"s == opt)      return Configuration::Suite::SINGLE;
         if ("bench-mco"s == opt)   return Configuration::Suite::BENCH_MCO;
         if ("popsize-mco"s == opt) return Configuration::Suite::POPSIZE_MCO;
+        if ("bench-load"s == opt)  return Configuration::Suite::BENCH_LOAD;
+        if ("bench-tour"s == opt)  return Configuration::Suite::BENCH_TOUR;
+        if ("bench-step"s == opt)  return Configuration::Suite::BENCH_STEP;
+        if ("bench-descent"s == opt) return Configuration::Suite::BENCH_DESCENT;
+        if ("bench-construction"s == opt) return Configuration::Suite::BENCH_CONSTRUCTION;
+        if ("bench-tick"s == opt)  return Configuration::Suite::BENCH_TICK;
 
         throw std::out_of_range("Unknown suite: "s + opt);
     }
@@ -117,6 +136,7 @@ struct Parser
 
         if ("det-construction"s == opt)  return Configuration::Algorithm::DET_CONSTRUCTION;
         if ("rand-construction"s == opt) return Configuration::Algorithm::RAND_CONSTRUCTION;
+        if ("bal-construction"s == opt)  return Configuration::Algorithm::BAL_CONSTRUCTION;
         if ("local-search"s == opt)      return Configuration::Algorithm::LOCAL_SEARCH;
         if ("grasp"s == opt)             return Configuration::Algorithm::GRASP;
         if ("vnd"s == opt)               return Configuration::Algorithm::VND;
@@ -144,6 +164,24 @@ struct Parser
         throw std::out_of_range("Unknown step function: "s + opt);
     }
 
+    /**
+     * Interpret the next argument value as a tour layout specification.
+     *
+     * @return: the argument parsed into a TourLayout
+     * @throw std::out_of_range: if the argument cannot be interpreted
+     */
+    TourLayout tourLayout()
+    {
+        using namespace std::string_literals;
+
+        const auto opt = next();
+
+        if ("array"s == opt)     return TourLayout::ARRAY;
+        if ("two-level"s == opt) return TourLayout::TWO_LEVEL;
+
+        throw std::out_of_range("Unknown tour layout: "s + opt);
+    }
+
     /**
      * Interpret the next argument value as a reinforcement strategy specification.
      *
@@ -179,6 +217,17 @@ struct Parser
         return value;
     }
 
+    /**
+     * Interpret the next argument value as a random seed.
+     *
+     * @return: the argument parsed into an unsigned 64-bit integer
+     * @throw std::invalid_argument: if the argument is not a number
+     */
+    std::uint64_t seedArg()
+    {
+        return std::stoull(next());
+    }
+
     /**
      * Interpret the next argument value as a floating-point value.
      *
@@ -225,6 +274,10 @@ void Configuration::readArgv(int argc, const char* argv[])
         case Parser::Token::SUITE:        suite = parser.suite(); break;
         case Parser::Token::ALGORITHM:    algorithm = parser.algorithm(); break;
         case Parser::Token::STEP:         stepFunction = parser.stepFunction(); break;
+        case Parser::Token::TOUR:         tourLayout = parser.tourLayout(); break;
+        case Parser::Token::DONT_LOOK:    dontLookBits = true; break;
+        case Parser::Token::DELTA_CACHE:  deltaStore = DeltaStore::CACHE; break;
+        case Parser::Token::DELTA_INDEX:  deltaStore = DeltaStore::INDEX; break;
         case Parser::Token::ITERATIONS:   iterations = parser.intArg(); break;
         case Parser::Token::POPSIZE:      popsize = parser.intArg(); break;
         case Parser::Token::EVAPORATION:  evaporation = parser.floatArg(0.f, 1.f); break;
@@ -235,8 +288,14 @@ void Configuration::readArgv(int argc, const char* argv[])
         case Parser::Token::OBJECTIVE_ATTRACTION: objectiveAttraction = parser.floatArg(); break;
         case Parser::Token::INTENSIFICATION: intensification = parser.floatArg(0.f, 1.f); break;
         case Parser::Token::REINFORCE_STRATEGY: reinforceStrategy = parser.reinforceStrategy(); break;
+        case Parser::Token::CANDIDATES:   candidates = parser.intArg(0); break;
         case Parser::Token::RUNS:         runs = parser.intArg(); break;
+        case Parser::Token::THREADS:      threads = parser.intArg(0); break;
+        case Parser::Token::SEARCH_THREADS: searchThreads = parser.intArg(0); break;
+        case Parser::Token::BATCH:        batch = true; break;
+        case Parser::Token::SEED:         seed = parser.seedArg(); break;
         case Parser::Token::STATS_OUT:    statsOutfile = parser.pathArg(); break;
+        case Parser::Token::COMPILE_INSTANCE: compileInstance = true; break;
         case Parser::Token::OPT_END:
             inputFiles.insert(inputFiles.end(), &parser.argv[1], &parser.argv[parser.argc]);
             parser.argc = 1;
@@ -249,6 +308,7 @@ void Configuration::readArgv(int argc, const char* argv[])
     }
 
     validateInputFiles();
+    validateSuite();
 }
 
 void Configuration::validateInputFiles() const
@@ -262,6 +322,19 @@ void Configuration::validateInputFiles() const
         throw input_files_error(nonFiles);
 }
 
+void Configuration::validateSuite() const
+{
+    if (Suite::SINGLE == suite)
+        return;
+
+    // the benchmarks report times per run or per iteration
+    if (runs < 1)
+        throw std::out_of_range(format("Benchmark suites need at least one run: {}", runs));
+
+    if (iterations < 1)
+        throw std::out_of_range(format("Benchmark suites need at least one iteration: {}", iterations));
+}
+
 input_files_error::input_files_error(const InputFiles& nonFiles)
     : exception(), nonFiles_(nonFiles), what_(buildWhat(nonFiles))
 {
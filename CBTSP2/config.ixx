@@ -6,9 +6,13 @@ module;
 #include <vector>
 #include <filesystem>
 #include <exception>
+#include <optional>
+#include <cstdint>
 
 export module config;
 
+import cbtsp;
+import local;
 import mco;
 
 using InputFiles = std::vector<std::filesystem::path>; //!< Type of input files list
@@ -30,12 +34,12 @@ public:
      * Enumeration of available preset run suites, which cover multiple configurations.
      * to run as the main mode of the program.
      */
-    enum class Suite { SINGLE, BENCH_MCO, POPSIZE_MCO };
+    enum class Suite { SINGLE, BENCH_MCO, POPSIZE_MCO, BENCH_LOAD, BENCH_TOUR, BENCH_STEP, BENCH_DESCENT, BENCH_CONSTRUCTION, BENCH_TICK };
 
     /**
      * Enumeration of available heuristics to run as the main mode of the program.
      */
-    enum class Algorithm { DET_CONSTRUCTION, RAND_CONSTRUCTION, LOCAL_SEARCH, GRASP, VND, MCO };
+    enum class Algorithm { DET_CONSTRUCTION, RAND_CONSTRUCTION, BAL_CONSTRUCTION, LOCAL_SEARCH, GRASP, VND, MCO };
 
     /**
      * Enumeration of available step functions to use in local search.
@@ -45,6 +49,9 @@ public:
     Suite suite = Suite::SINGLE; //!< run preset
     Algorithm algorithm = Algorithm::GRASP; //!< main search mode
     StepFunction stepFunction = StepFunction::BEST_IMPROVEMENT; //!< step strategy for local search
+    TourLayout tourLayout = TourLayout::ARRAY; //!< tour data structure for local search
+    bool dontLookBits = false; //!< local search only scans around recently changed vertices
+    DeltaStore deltaStore = DeltaStore::NONE; //!< where best improvement keeps the move values across steps
     int iterations = 100; //!< number of iterations for GRASP and MCO
     int popsize = 100; //!< MCO: number of mice
     float evaporation = .1f; //!< MCO: fraction of pheromone decrease per tick
@@ -55,7 +62,13 @@ public:
     float objectiveAttraction = 1.f; //!< MCO: to which degree local objective value attracts
     float intensification = .5f; //!< MCO: chance of choosing best step
     ReinforceStrategy reinforceStrategy = ReinforceStrategy::LAMARCK; //!< MCO: pheromone update source
+    int candidates = 0; //!< MCO: number of candidate edges per vertex, 0 for all vertices
     int runs = 100; //!< number of search attempts for statistical samples
+    int threads = 1; //!< number of worker threads for the search attempts, 0 for one per hardware thread
+    int searchThreads = 1; //!< number of worker threads within one search, 0 for one per hardware thread
+    bool batch = false; //!< schedule the runs on all input files as one batch of tasks
+    std::optional<std::uint64_t> seed; //!< master seed for random numbers, from the clock if empty
+    bool compileInstance = false; //!< convert the input files to binary format instead of solving them
     std::filesystem::path statsOutfile; //!< output file for statistical results
     InputFiles inputFiles; //!< CBTSP problem instance files
 
@@ -67,6 +80,12 @@ private:
      */
     void validateInputFiles() const;
 
+    /**
+     * Check that the benchmark suites get at least one run and one iteration to average over.
+     * Otherwise, throw an `std::out_of_range`.
+     */
+    void validateSuite() const;
+
 };
 
 /**
@@ -3,7 +3,7 @@ module;
 #include <cstddef>
 #include <algorithm>
 #include <numeric>
-#include <ranges>
+#include <limits>
 #include <memory>
 #include <utility>
 #include <vector>
@@ -12,18 +12,47 @@ module;
 
 module construction;
 
-std::vector<Vertex> selectables(const Problem& problem, const Solution& partialSolution)
+VertexPool::VertexPool(std::size_t vertices)
+    : vertices_(vertices), positions_(vertices)
 {
-    std::vector<Vertex> all(problem.vertices());
-    std::iota(all.begin(), all.end(), 0);
-    std::vector<Vertex> unselectable = partialSolution.vertices();
-    std::ranges::sort(unselectable);
+    std::iota(vertices_.begin(), vertices_.end(), 0);
+    std::iota(positions_.begin(), positions_.end(), 0);
+}
+
+VertexPool::VertexPool(const Problem& problem, const Solution& partialSolution)
+    : VertexPool(problem.vertices())
+{
+    for (const Vertex vertex : partialSolution.vertices())
+        remove(vertex);
+}
 
-    // get just the selectables
-    std::vector<Vertex> selectable(problem.vertices() - partialSolution.length());
-    std::ranges::set_difference(all, unselectable, selectable.begin());
+std::size_t VertexPool::size() const noexcept
+{
+    return vertices_.size();
+}
 
-    return selectable;
+bool VertexPool::contains(Vertex vertex) const noexcept
+{
+    return npos != positions_[vertex];
+}
+
+Vertex VertexPool::operator[](std::size_t index) const noexcept
+{
+    assert(index < vertices_.size());
+    return vertices_[index];
+}
+
+void VertexPool::remove(Vertex vertex) noexcept
+{
+    assert(contains(vertex));
+
+    // move the last vertex into the gap
+    const std::size_t position = positions_[vertex];
+    const Vertex last = vertices_.back();
+    vertices_[position] = last;
+    positions_[last] = position;
+    vertices_.pop_back();
+    positions_[vertex] = npos;
 }
 
 RandomSelector::RandomSelector(const std::shared_ptr<Random>& random) noexcept
@@ -32,87 +61,319 @@ RandomSelector::RandomSelector(const std::shared_ptr<Random>& random) noexcept
     assert(random);
 }
 
+Vertex RandomSelector::select(const Problem& problem, const Solution& partialSolution, const VertexPool& pool)
+{
+    assert(pool.size() > 0);
+    auto distribution = std::uniform_int_distribution<std::size_t>{ 0, pool.size() - 1 };
+    return pool[distribution(*random_)];
+}
+
 Vertex RandomSelector::select(const Problem& problem, const Solution& partialSolution)
 {
-    const auto selectable = selectables(problem, partialSolution);
-    const auto distribution = std::uniform_int_distribution{ 0ull, selectable.size() - 1 };
-    return selectable[distribution(*random_)];
+    return select(problem, partialSolution, VertexPool(problem, partialSolution));
+}
+
+Vertex FarthestCitySelector::select(const Problem& problem, const Solution& partialSolution, const VertexPool& pool)
+{
+    const std::size_t length = partialSolution.length();
+
+    if (0 == length) {
+        reset(problem);
+        last_ = 0;
+        return 0; // start from vertex 0
+    }
+
+    if (distances_.size() == problem.vertices() && merged_ + 1 == length && !pool.contains(last_)) {
+        merge(problem, last_);
+    }
+    else {
+        reset(problem);
+        for (const Vertex vertex : partialSolution.vertices())
+            merge(problem, vertex);
+    }
+
+    // The lowest candidate stands unless a farther one is found.
+    // Of all candidates which are farther, the lowest farthest is chosen.
+    // Since the pool is unordered, we track both and decide in the end.
+    assert(pool.size() > 0);
+    const Value bigM = problem.bigM();
+    const Value absBigM = std::abs(bigM);
+    Vertex lowest = pool[0];
+    Value lowestDistance = 0;
+    Vertex farthest = pool[0];
+    Value farthestDistance = -1;
+
+    for (std::size_t i = 0; i < pool.size(); i++) {
+        const Vertex candidate = pool[i];
+        const Value distance = this->distance(candidate, absBigM);
+
+        if (0 == i || candidate < lowest) {
+            lowest = candidate;
+            lowestDistance = distance;
+        }
+
+        // preferably avoid big-M edges in the farthest that we're looking for
+        if (distance != bigM && (distance > farthestDistance ||
+            (distance == farthestDistance && candidate < farthest))) {
+            farthest = candidate;
+            farthestDistance = distance;
+        }
+    }
+
+    last_ = farthestDistance > lowestDistance ? farthest : lowest;
+    return last_;
 }
 
 Vertex FarthestCitySelector::select(const Problem& problem, const Solution& partialSolution)
 {
-    if (0 == partialSolution.length())
+    reset(problem);
+    return select(problem, partialSolution, VertexPool(problem, partialSolution));
+}
+
+void FarthestCitySelector::reset(const Problem& problem)
+{
+    distances_.assign(problem.vertices(), std::numeric_limits<Value>::max());
+    adjacent_.assign(problem.vertices(), 0);
+    merged_ = 0;
+}
+
+void FarthestCitySelector::merge(const Problem& problem, Vertex vertex)
+{
+    const auto neighbors = problem.neighbors(vertex);
+    const auto values = problem.neighborValues(vertex);
+
+    for (std::size_t i = 0; i < neighbors.size(); i++) {
+        const Vertex neighbor = neighbors[i];
+        distances_[neighbor] = std::min(distances_[neighbor], std::abs(values[i]));
+        adjacent_[neighbor]++;
+    }
+
+    merged_++;
+}
+
+Value FarthestCitySelector::distance(Vertex vertex, Value absBigM) const noexcept
+{
+    // every merged vertex without a real edge to this one is big-M away
+    if (adjacent_[vertex] < merged_)
+        return std::min(distances_[vertex], absBigM);
+    else
+        return distances_[vertex];
+}
+
+Vertex BalancedSelector::select(const Problem& problem, const Solution& partialSolution, const VertexPool& pool)
+{
+    assert(pool.size() > 0);
+    const std::size_t length = partialSolution.length();
+
+    if (0 == length) {
+        length_ = 0;
+        last_ = 0;
         return 0; // start from vertex 0
+    }
 
-    const auto selectable = selectables(problem, partialSolution);
+    if (1 == length) {
+        // the first edge goes back and forth, so its value counts twice
+        const Vertex first = partialSolution.vertices()[0];
+        Value bestObjective = std::numeric_limits<Value>::max();
 
-    // Function to evaluate distance to specific selection candidates
-    struct DistanceTo
-    {
-        const Problem& problem;
-        Vertex fixpoint; // vertex to measure distance to
-        Value operator()(Vertex vertex) const
-        {
-            return std::abs(problem.value(fixpoint, vertex));
+        for (std::size_t i = 0; i < pool.size(); i++) {
+            const Vertex candidate = pool[i];
+            const Value objective = std::abs(2 * problem.value(first, candidate));
+            if (objective < bestObjective || (objective == bestObjective && candidate < last_)) {
+                last_ = candidate;
+                bestObjective = objective;
+            }
         }
-    };
 
-    // Function to find out the min distance from a candidate to the partial solution
-    using DVPair = std::pair<Value, Vertex>;
-    auto getMinDistance = [&problem, &partialSolution](Vertex candidate) -> DVPair
+        length_ = 1;
+        return last_;
+    }
+
+    if (edges_.size() == problem.vertices() && length_ >= 2 && length_ + 1 == length && !pool.contains(last_))
+        split(problem, partialSolution, pool, last_);
+    else
+        rebuild(problem, partialSolution, pool);
+
+    length_ = length;
+
+    // look for the live entry nearest to the target in every run
+    const Value target = -partialSolution.value();
+    Value bestObjective = std::numeric_limits<Value>::max();
+    const auto consider = [this, &pool, &bestObjective](const Entry& entry, Value objective)
     {
-        const auto distanceTo = DistanceTo{ problem, candidate };
-        const auto distances = std::ranges::transform_view(partialSolution.vertices(), distanceTo);
-        const Value minDistance = *std::ranges::min_element(distances);
-        return std::make_pair(minDistance, candidate);
+        if (live(entry, pool) && (objective < bestObjective ||
+            (objective == bestObjective && entry.vertex < last_))) {
+            last_ = entry.vertex;
+            bestObjective = objective;
+        }
     };
 
-    // Find all selection candidates paired with their evaluated distance
-    const auto evaluation = std::ranges::transform_view(selectable, getMinDistance);
+    for (std::size_t r = 0; r < runEnds_.size(); r++) {
+        const Entry* begin = entries_.data() + (0 == r ? 0 : runEnds_[r - 1]);
+        const Entry* end = entries_.data() + runEnds_[r];
+        const Entry* mid = std::lower_bound(begin, end, Entry{ target, 0, 0 });
 
-    // return the farthest candidate
-    const Value bigM = problem.bigM();
-    const auto greaterDistance = [bigM](DVPair dv1, DVPair dv2)
+        for (const Entry* it = mid; it != end && it->delta - target <= bestObjective; ++it)
+            consider(*it, it->delta - target);
+
+        for (const Entry* it = mid; it != begin && target - (it - 1)->delta <= bestObjective; --it)
+            consider(*(it - 1), target - (it - 1)->delta);
+    }
+
+    assert(bestObjective < std::numeric_limits<Value>::max());
+    return last_;
+}
+
+Vertex BalancedSelector::select(const Problem& problem, const Solution& partialSolution)
+{
+    length_ = 0;
+    return select(problem, partialSolution, VertexPool(problem, partialSolution));
+}
+
+bool BalancedSelector::live(const Entry& entry, const VertexPool& pool) const noexcept
+{
+    return pool.contains(entry.vertex) && edges_[tails_[entry.edge]] == entry.edge;
+}
+
+void BalancedSelector::rebuild(const Problem& problem, const Solution& partialSolution, const VertexPool& pool)
+{
+    const auto& vertices = partialSolution.vertices();
+    const std::size_t length = vertices.size();
+
+    entries_.clear();
+    runEnds_.clear();
+    edges_.assign(problem.vertices(), 0);
+    tails_.clear();
+    tailRow_.assign(problem.vertices(), problem.bigM());
+    headRow_.assign(problem.vertices(), problem.bigM());
+
+    for (std::size_t i = 0; i < length; i++)
+        addEdge(problem, pool, vertices[i], vertices[(i + 1) % length]);
+
+    addRun(0);
+}
+
+void BalancedSelector::split(const Problem& problem, const Solution& partialSolution, const VertexPool& pool, Vertex vertex)
+{
+    const auto& vertices = partialSolution.vertices();
+    const std::size_t length = vertices.size();
+    const std::size_t pos = std::find(vertices.begin(), vertices.end(), vertex) - vertices.begin();
+    assert(pos < length);
+
+    const Vertex prev = vertices[(pos + length - 1) % length];
+    const Vertex next = vertices[(pos + 1) % length];
+
+    // the new edges replace the tour edge from prev, which makes its entries stale
+    const std::size_t begin = entries_.size();
+    addEdge(problem, pool, prev, vertex);
+    addEdge(problem, pool, vertex, next);
+    addRun(begin);
+
+    // every pair of a remaining vertex and a tour edge has exactly one live entry
+    if (entries_.size() > 2 * pool.size() * length + problem.vertices())
+        compact(pool);
+}
+
+void BalancedSelector::addEdge(const Problem& problem, const VertexPool& pool, Vertex tail, Vertex head)
+{
+    const auto edge = static_cast<std::uint32_t>(tails_.size());
+    edges_[tail] = edge;
+    tails_.push_back(tail);
+
+    // scatter the real edges of both ends into their rows
+    const auto scatter = [&problem](std::vector<Value>& row, Vertex vertex, bool set)
     {
-        // preferably avoid big-M edges in the farthest that we're looking for
-        return (dv1.first != bigM) && dv1.first > dv2.first;
+        const auto neighbors = problem.neighbors(vertex);
+        const auto values = problem.neighborValues(vertex);
+        for (std::size_t i = 0; i < neighbors.size(); i++)
+            row[neighbors[i]] = set ? values[i] : problem.bigM();
     };
-    return (*std::ranges::min_element(evaluation, greaterDistance)).second;
+
+    scatter(tailRow_, tail, true);
+    scatter(headRow_, head, true);
+
+    const Value removed = problem.value(tail, head);
+    for (std::size_t i = 0; i < pool.size(); i++) {
+        const Vertex vertex = pool[i];
+        entries_.push_back({ tailRow_[vertex] + headRow_[vertex] - removed, vertex, edge });
+    }
+
+    scatter(tailRow_, tail, false);
+    scatter(headRow_, head, false);
+}
+
+void BalancedSelector::addRun(std::size_t begin)
+{
+    std::sort(entries_.begin() + begin, entries_.end());
+    runEnds_.push_back(entries_.size());
+
+    while (runEnds_.size() >= 2) {
+        const std::size_t last = runEnds_.size() - 1;
+        const std::size_t lastBegin = runEnds_[last - 1];
+        const std::size_t prevBegin = last >= 2 ? runEnds_[last - 2] : 0;
+
+        if (runEnds_[last] - lastBegin < lastBegin - prevBegin)
+            break;
+
+        std::inplace_merge(entries_.begin() + prevBegin, entries_.begin() + lastBegin, entries_.begin() + runEnds_[last]);
+        runEnds_.erase(runEnds_.end() - 2);
+    }
+}
+
+void BalancedSelector::compact(const VertexPool& pool)
+{
+    const auto stale = [this, &pool](const Entry& entry) { return !live(entry, pool); };
+    entries_.erase(std::remove_if(entries_.begin(), entries_.end(), stale), entries_.end());
+    runEnds_.clear();
+    addRun(0);
 }
 
-void BestTourInserter::insert(const Problem& problem, Solution& partialSolution, Vertex nextVertex) const
+void BestTourInserter::insert(const Problem& problem, Solution& partialSolution, Vertex nextVertex)
 {
-    const auto length = partialSolution.length();
+    const auto& vertices = partialSolution.vertices();
+    const auto length = vertices.size();
 
     if (length < 2) {
         partialSolution.insert(0, nextVertex);
         return;
     }
 
-    // get a list of all possible inserts
-    auto evaluation = std::vector<Value>(length);
-    for (std::size_t i = 0; i < length; i++) {
-        evaluation[i] = tourObjective(problem, partialSolution, nextVertex, i);
-    }
+    // scatter the real edges of the next vertex into the row
+    const Value bigM = problem.bigM();
+    if (row_.size() != problem.vertices() || row_[nextVertex] != bigM)
+        row_.assign(problem.vertices(), bigM);
 
-    // find the best one
-    const auto minAt = std::min_element(evaluation.begin(), evaluation.end());
+    const auto neighbors = problem.neighbors(nextVertex);
+    const auto values = problem.neighborValues(nextVertex);
+    for (std::size_t i = 0; i < neighbors.size(); i++)
+        row_[neighbors[i]] = values[i];
 
-    // apply next vertex at best position
-    partialSolution.insert(minAt - evaluation.begin(), nextVertex);
-}
+    // find the first position with the best tour value, in one pass
+    const Value base = partialSolution.value();
+    std::size_t bestPos = 0;
+    Value bestObjective = std::numeric_limits<Value>::max();
+    Vertex prev = vertices[length - 1];
+    Value prevValue = row_[prev];
 
-Value BestTourInserter::tourObjective(const Problem& problem, Solution& partialSolution, Vertex nextVertex, std::size_t pos)
-{
-    const auto vertices = partialSolution.vertices();
-    const auto n = vertices.size();
+    for (std::size_t i = 0; i < length; i++) {
+        const Vertex next = vertices[i];
+        const Value nextValue = row_[next];
+        const Value objective = std::abs(base + prevValue + nextValue - problem.value(prev, next));
 
-    const Vertex prev = vertices[(pos + n - 1) % n];
-    const Vertex next = vertices[pos];
+        if (objective < bestObjective) {
+            bestPos = i;
+            bestObjective = objective;
+        }
 
-    return std::abs(partialSolution.value()
-        + problem.value(prev, nextVertex) + problem.value(nextVertex, next)
-        - problem.value(prev, next));
+        prev = next;
+        prevValue = nextValue;
+    }
+
+    for (const Vertex neighbor : neighbors)
+        row_[neighbor] = bigM;
+
+    // apply next vertex at best position
+    partialSolution.insert(bestPos, nextVertex);
 }
 
 ConstructionSearch::ConstructionSearch(std::unique_ptr<Construction> construction) noexcept
@@ -6,16 +6,70 @@ module;
 #include <random>
 #include <utility>
 #include <memory>
+#include <vector>
+#include <cstdint>
 
 export module construction;
 
 export import cbtsp;
 
 /**
- * Calculate the set of vertices in the problem which are available
- * to the selection strategy, i.e. all those not yet part of the solution.
+ * The set of vertices which are not yet part of a partial solution.
+ *
+ * The vertices are kept in an array in no particular order, so that selection
+ * strategies can pick one by index in O(1). A vertex is removed by moving the
+ * last vertex of the array into its place, which the vertex positions allow in O(1).
  */
-std::vector<Vertex> selectables(const Problem& problem, const Solution& partialSolution);
+export class VertexPool
+{
+
+public:
+
+    /**
+     * Construct the pool of all vertices of a problem.
+     *
+     * @param vertices: number of vertices in the problem
+     */
+    explicit VertexPool(std::size_t vertices);
+
+    /**
+     * Construct the pool of all vertices which are not part of the partial solution.
+     *
+     * @param problem: problem instance object
+     * @param partialSolution: partial Solution object
+     */
+    explicit VertexPool(const Problem& problem, const Solution& partialSolution);
+
+    /**
+     * Get the number of vertices in the pool.
+     */
+    std::size_t size() const noexcept;
+
+    /**
+     * Determine whether the vertex is in the pool.
+     */
+    bool contains(Vertex vertex) const noexcept;
+
+    /**
+     * Get the vertex at the given index in the pool.
+     */
+    Vertex operator[](std::size_t index) const noexcept;
+
+    /**
+     * Remove the vertex from the pool. This changes the order of the pool.
+     *
+     * @param vertex: vertex in the pool
+     */
+    void remove(Vertex vertex) noexcept;
+
+private:
+
+    std::vector<Vertex> vertices_; //!< vertices in the pool, in any order
+    std::vector<std::size_t> positions_; //!< index of each vertex in the pool, or npos if removed
+
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1); //!< position of removed vertices
+
+};
 
 /**
  * Random selection strategy.
@@ -34,6 +88,16 @@ public:
      */
     explicit RandomSelector(const std::shared_ptr<Random>& random) noexcept;
 
+    /**
+     * Choose any random next vertex from the instance which is not yet part of the solution.
+     *
+     * @param problem: problem instance object
+     * @param partialSolution: partial Solution object
+     * @param pool: vertices which are not yet part of the solution
+     * @return: random next vertex
+     */
+    Vertex select(const Problem& problem, const Solution& partialSolution, const VertexPool& pool);
+
     /**
      * Choose any random next vertex from the instance which is not yet part of the solution.
      *
@@ -51,12 +115,31 @@ private:
 
 /**
  * Farthest city selection strategy.
+ *
+ * Like Prim's algorithm, the selector keeps the minimum distance of every candidate
+ * to the partial solution. When it is called again during the same construction,
+ * it only updates the distances against the vertex which it selected last,
+ * along the real edges of that vertex.
  */
 export class FarthestCitySelector
 {
 
 public:
 
+    /**
+     * Choose the vertex whose minimum absolute value to any existing
+     * partial - solution vertex is maximum.
+     *
+     * Between calls, the partial solution is expected to grow by the vertex
+     * which was selected last. If it does not, the distances are recomputed.
+     *
+     * @param problem: problem instance object
+     * @param partialSolution: partial Solution object
+     * @param pool: vertices which are not yet part of the solution
+     * @return: farthest next vertex
+     */
+    Vertex select(const Problem& problem, const Solution& partialSolution, const VertexPool& pool);
+
     /**
      * Choose the vertex whose minimum absolute value to any existing
      * partial - solution vertex is maximum.
@@ -67,13 +150,126 @@ public:
      */
     Vertex select(const Problem& problem, const Solution& partialSolution);
 
+private:
+
+    std::vector<Value> distances_; //!< minimum absolute value of real edges from each vertex to the merged vertices
+    std::vector<std::size_t> adjacent_; //!< number of merged vertices with a real edge to each vertex
+    std::size_t merged_ = 0; //!< number of partial solution vertices in the distances
+    Vertex last_ = 0; //!< vertex selected in the last call
+
+    /**
+     * Forget all distances and prepare for a new problem instance.
+     */
+    void reset(const Problem& problem);
+
+    /**
+     * Update the distances of all vertices with the distances to the given vertex.
+     */
+    void merge(const Problem& problem, Vertex vertex);
+
+    /**
+     * Get the minimum absolute value from the vertex to the merged vertices.
+     */
+    Value distance(Vertex vertex, Value absBigM) const noexcept;
+
 };
 
+/**
+ * Balanced insertion selection strategy.
+ *
+ * The next vertex is the one which can be inserted into the partial solution such that the
+ * absolute tour value becomes minimal. For this, the selector keeps the value change of inserting
+ * every remaining vertex into every tour edge. Since the target value changes with every insertion,
+ * the changes are not kept in a heap, but sorted in runs, in which the selector looks up the changes
+ * nearest to the negated tour value. After an insertion, only the changes for the new edges are added.
+ */
+export class BalancedSelector
+{
+
+public:
+
+    /**
+     * Choose the vertex which can be inserted with the lowest resulting absolute tour value.
+     *
+     * Between calls, the partial solution is expected to grow by the vertex
+     * which was selected last. If it does not, all value changes are recomputed.
+     *
+     * @param problem: problem instance object
+     * @param partialSolution: partial Solution object
+     * @param pool: vertices which are not yet part of the solution
+     * @return: most balanced next vertex
+     */
+    Vertex select(const Problem& problem, const Solution& partialSolution, const VertexPool& pool);
+
+    /**
+     * Choose the vertex which can be inserted with the lowest resulting absolute tour value.
+     *
+     * @param problem: problem instance object
+     * @param partialSolution: partial Solution object
+     * @return: most balanced next vertex
+     */
+    Vertex select(const Problem& problem, const Solution& partialSolution);
+
+private:
+
+    //! The value change of inserting a vertex into a tour edge.
+    struct Entry
+    {
+        Value delta; //!< value change of the insertion
+        Vertex vertex; //!< vertex to insert
+        std::uint32_t edge; //!< id of the tour edge
+
+        bool operator<(const Entry& rhs) const noexcept { return delta < rhs.delta; }
+    };
+
+    std::vector<Entry> entries_; //!< all runs, one after another
+    std::vector<std::size_t> runEnds_; //!< end of each run in the entries
+    std::vector<std::uint32_t> edges_; //!< id of the tour edge which leaves each vertex
+    std::vector<Vertex> tails_; //!< start vertex of the tour edge with each id
+    std::vector<Value> tailRow_; //!< scratch: values from the tail of a new edge, big-M if none
+    std::vector<Value> headRow_; //!< scratch: values from the head of a new edge, big-M if none
+    std::size_t length_ = 0; //!< length of the partial solution in the entries
+    Vertex last_ = 0; //!< vertex selected in the last call
+
+    /**
+     * Determine whether the entry still describes an insertion into the partial solution.
+     */
+    bool live(const Entry& entry, const VertexPool& pool) const noexcept;
+
+    /**
+     * Compute the entries for all edges of the partial solution.
+     */
+    void rebuild(const Problem& problem, const Solution& partialSolution, const VertexPool& pool);
+
+    /**
+     * Add the entries for the edges which replaced the tour edge into which the vertex was inserted.
+     */
+    void split(const Problem& problem, const Solution& partialSolution, const VertexPool& pool, Vertex vertex);
+
+    /**
+     * Append the entries for a new tour edge from tail to head and all vertices in the pool.
+     */
+    void addEdge(const Problem& problem, const VertexPool& pool, Vertex tail, Vertex head);
+
+    /**
+     * Sort the entries from `begin` as a new run and merge the trailing runs while
+     * the last run is at least as large as the one before.
+     */
+    void addRun(std::size_t begin);
+
+    /**
+     * Drop all stale entries and merge the remaining runs into one.
+     */
+    void compact(const VertexPool& pool);
+
+};
 
 /**
  * Vertex insertion strategy.
  *
  * The new vertex is placed in the tour to minimize the absolute intermediate tour value.
+ * All positions are evaluated in a single pass over the tour, looking up the values of
+ * the new vertex in a full row which the inserter keeps between insertions.
  */
 export class BestTourInserter
 {
@@ -87,20 +283,11 @@ public:
      * @param partialSolution: partial Solution object to modify
      * @param nextVertex: vertex number
      */
-    void insert(const Problem& problem, Solution& partialSolution, Vertex nextVertex) const;
+    void insert(const Problem& problem, Solution& partialSolution, Vertex nextVertex);
 
 private:
 
-    /**
-     * Determine the value of the tour which results from inserting the next vertex at the specified spot in the tour.
-     *
-     * @param problem: problem instance object
-     * @param partialSolution: partial Solution object, state restored after experiment
-     * @param nextVertex: vertex number
-     * @param pos: index before which to insert the next vertex in the tour
-     * @return: the value of the resulting tour
-     */
-    static Value tourObjective(const Problem& problem, Solution& partialSolution, Vertex nextVertex, std::size_t pos);
+    std::vector<Value> row_; //!< values from the next vertex to every vertex, big-M between insertions
 
 };
 
@@ -129,6 +316,7 @@ public:
  * Constructs a full - length CBTSP solution based on a selection strategy and an insertion strategy.
  *
  * The selection strategy specifies the next vertex to be added to the tour.
+ * It picks from a pool of the remaining vertices, which lives for the whole construction.
  * The insertion strategy defines where the next vertex should be inserted in the partial solution.
  */
 export template<typename SelectionStrategy> class SelectInsertConstruction : public Construction
@@ -156,8 +344,11 @@ public:
     Solution construct(const Problem& problem) override
     {
         auto solution = Solution(problem, {});
+        auto pool = VertexPool(problem.vertices());
+
         for (std::size_t i = 0; i < problem.vertices(); i++) {
-            const Vertex next = selector_.select(problem, solution);
+            const Vertex next = selector_.select(problem, solution, pool);
+            pool.remove(next);
             inserter_.insert(problem, solution, next);
         }
 
@@ -173,6 +364,7 @@ private:
 
 export using RandomConstruction = SelectInsertConstruction<RandomSelector>;
 export using DeterministicConstruction = SelectInsertConstruction<FarthestCitySelector>;
+export using BalancedConstruction = SelectInsertConstruction<BalancedSelector>;
 
 /**
  * This is a simple search algorithm that will use the result of
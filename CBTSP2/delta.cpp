@@ -0,0 +1,429 @@
+module;
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include <array>
+#include <utility>
+#include <algorithm>
+#include <cassert>
+
+module local;
+
+// Order index keys by value change.
+bool operator<(const DeltaIndex::Key& lhs, const DeltaIndex::Key& rhs) noexcept
+{
+    return lhs.delta < rhs.delta;
+}
+
+EdgeSlots::Change EdgeSlots::sync(const Solution& base)
+{
+    auto change = Change::NONE;
+
+    if (Move::Kind::TWO_EXCHANGE == expected_.kind && &base.problem() == problem_) {
+        const auto [low, high] = std::minmax(expected_.cut1, expected_.cut2);
+        const std::size_t n = tour_.size();
+        const std::size_t lowSlot = slots_[low];
+        const std::size_t highSlot = slots_[high];
+
+        // replay the reversal; the edges inside the reversed part keep their slots
+        std::reverse(tour_.begin() + low, tour_.begin() + high);
+        std::reverse(slots_.begin() + low + 1, slots_.begin() + high);
+        for (std::size_t cut = low + 1; cut < high; cut++)
+            cuts_[slots_[cut]] = cut;
+        orient(low + 1, high);
+
+        // the exchanged edges get new ends
+        ends_[lowSlot] = { tour_[(low + n - 1) % n], tour_[low] };
+        ends_[highSlot] = { tour_[high - 1], tour_[high] };
+        forward_[low] = true;
+        forward_[high] = true;
+        edgeValues_[lowSlot] = problem_->value(ends_[lowSlot].first, ends_[lowSlot].second);
+        edgeValues_[highSlot] = problem_->value(ends_[highSlot].first, ends_[highSlot].second);
+
+        changed_ = { lowSlot, highSlot };
+        change = Change::MOVE;
+    }
+
+    expected_ = {};
+
+    if (&base.problem() != problem_ || base.vertices() != tour_) {
+        rebuild(base);
+        change = Change::ALL;
+    }
+
+    return change;
+}
+
+void EdgeSlots::expect(Move move) noexcept
+{
+    expected_ = move;
+}
+
+std::size_t EdgeSlots::size() const noexcept
+{
+    return slots_.size();
+}
+
+std::size_t EdgeSlots::slot(std::size_t cut) const noexcept
+{
+    return slots_[cut];
+}
+
+std::size_t EdgeSlots::cut(std::size_t slot) const noexcept
+{
+    return cuts_[slot];
+}
+
+bool EdgeSlots::forward(std::size_t cut) const noexcept
+{
+    return forward_[cut];
+}
+
+std::array<std::size_t, 2> EdgeSlots::changed() const noexcept
+{
+    return changed_;
+}
+
+void EdgeSlots::deltas(std::size_t slot, ExchangeDeltas* row)
+{
+    const std::size_t n = slots_.size();
+    const auto [first, second] = ends_[slot];
+    const auto firstNeighbors = problem_->neighbors(first);
+    const auto secondNeighbors = problem_->neighbors(second);
+    const auto firstValues = problem_->neighborValues(first);
+    const auto secondValues = problem_->neighborValues(second);
+
+    for (std::size_t i = 0; i < firstNeighbors.size(); i++)
+        firstRow_[firstNeighbors[i]] = firstValues[i];
+    for (std::size_t i = 0; i < secondNeighbors.size(); i++)
+        secondRow_[secondNeighbors[i]] = secondValues[i];
+
+    for (std::size_t other = 0; other < n; other++) {
+        const auto [otherFirst, otherSecond] = ends_[other];
+        const Value removed = edgeValues_[slot] + edgeValues_[other];
+        row[other] = {
+            firstRow_[otherFirst] + secondRow_[otherSecond] - removed,
+            firstRow_[otherSecond] + secondRow_[otherFirst] - removed
+        };
+    }
+
+    for (const Vertex neighbor : firstNeighbors)
+        firstRow_[neighbor] = problem_->bigM();
+    for (const Vertex neighbor : secondNeighbors)
+        secondRow_[neighbor] = problem_->bigM();
+}
+
+void EdgeSlots::rebuild(const Solution& base)
+{
+    problem_ = &base.problem();
+    tour_ = base.vertices();
+    const std::size_t n = tour_.size();
+
+    slots_.resize(n);
+    cuts_.resize(n);
+    forward_.assign(n, true);
+    ends_.resize(n);
+    edgeValues_.resize(n);
+    firstRow_.assign(problem_->vertices(), problem_->bigM());
+    secondRow_.assign(problem_->vertices(), problem_->bigM());
+
+    for (std::size_t cut = 0; cut < n; cut++) {
+        slots_[cut] = cut;
+        cuts_[cut] = cut;
+        ends_[cut] = { tour_[(cut + n - 1) % n], tour_[cut] };
+        edgeValues_[cut] = problem_->value(ends_[cut].first, ends_[cut].second);
+    }
+}
+
+void EdgeSlots::orient(std::size_t begin, std::size_t end) noexcept
+{
+    for (std::size_t cut = begin; cut < end; cut++)
+        forward_[cut] = tour_[cut - 1] == ends_[slots_[cut]].first;
+}
+
+void DeltaCache::sync(const Solution& base)
+{
+    const auto change = edges_.sync(base);
+    const std::size_t n = edges_.size();
+
+    if (EdgeSlots::Change::ALL == change) {
+        entries_.resize(n * n);
+
+        for (std::size_t slot = 0; slot < n; slot++)
+            edges_.deltas(slot, &entries_[slot * n]);
+    }
+    else if (EdgeSlots::Change::MOVE == change) {
+        for (const std::size_t slot : edges_.changed()) {
+            edges_.deltas(slot, &entries_[slot * n]);
+
+            // the entries are symmetric
+            for (std::size_t other = 0; other < n; other++)
+                entries_[other * n + slot] = entries_[slot * n + other];
+        }
+    }
+}
+
+void DeltaCache::expect(Move move) noexcept
+{
+    edges_.expect(move);
+}
+
+Value DeltaCache::delta(std::size_t cut1, std::size_t cut2) const noexcept
+{
+    const ExchangeDeltas& entry = row(edges_.slot(cut1))[edges_.slot(cut2)];
+    return edges_.forward(cut1) == edges_.forward(cut2) ? entry.same : entry.cross;
+}
+
+const EdgeSlots& DeltaCache::edges() const noexcept
+{
+    return edges_;
+}
+
+const ExchangeDeltas* DeltaCache::row(std::size_t slot) const noexcept
+{
+    return &entries_[slot * edges_.size()];
+}
+
+void DeltaIndex::sync(const Solution& base)
+{
+    const auto change = edges_.sync(base);
+
+    if (EdgeSlots::Change::ALL == change || (EdgeSlots::Change::MOVE == change &&
+        version_ == std::numeric_limits<std::uint32_t>::max() / 2)) {
+        rebuild();
+        return;
+    }
+
+    if (EdgeSlots::Change::MOVE == change) {
+        const std::size_t n = edges_.size();
+        const std::size_t begin = keys_.size();
+        const auto [lowSlot, highSlot] = edges_.changed();
+
+        version_++;
+        versions_[lowSlot] = version_;
+        versions_[highSlot] = version_;
+        addKeys(lowSlot, 0);
+        addKeys(highSlot, 0);
+
+        std::sort(keys_.begin() + begin, keys_.end());
+        runEnds_.push_back(keys_.size());
+        mergeRuns();
+
+        if (keys_.size() > 2 * n * (n - 1))
+            compact();
+    }
+}
+
+void DeltaIndex::expect(Move move) noexcept
+{
+    edges_.expect(move);
+}
+
+const EdgeSlots& DeltaIndex::edges() const noexcept
+{
+    return edges_;
+}
+
+std::size_t DeltaIndex::runs() const noexcept
+{
+    return runEnds_.size();
+}
+
+std::pair<const DeltaIndex::Key*, const DeltaIndex::Key*> DeltaIndex::run(std::size_t index) const noexcept
+{
+    const std::size_t begin = index > 0 ? runEnds_[index - 1] : 0;
+    return { keys_.data() + begin, keys_.data() + runEnds_[index] };
+}
+
+bool DeltaIndex::current(const Key& key) const noexcept
+{
+    const std::uint32_t version = key.stamp >> 1;
+    return versions_[key.first] <= version && versions_[key.second] <= version;
+}
+
+void DeltaIndex::rebuild()
+{
+    const std::size_t n = edges_.size();
+    assert(n <= std::numeric_limits<std::uint16_t>::max() + std::size_t{ 1 });
+
+    keys_.clear();
+    keys_.reserve(n * (n - 1));
+    versions_.assign(n, 0);
+    version_ = 0;
+
+    for (std::size_t slot = 0; slot < n; slot++)
+        addKeys(slot, slot + 1);
+
+    std::sort(keys_.begin(), keys_.end());
+    runEnds_.assign(1, keys_.size());
+}
+
+void DeltaIndex::addKeys(std::size_t slot, std::size_t begin)
+{
+    const std::size_t n = edges_.size();
+    row_.resize(n);
+    edges_.deltas(slot, row_.data());
+
+    for (std::size_t other = begin; other < n; other++) {
+        if (other == slot)
+            continue;
+
+        const auto first = static_cast<std::uint16_t>(slot);
+        const auto second = static_cast<std::uint16_t>(other);
+        keys_.push_back({ row_[other].same, first, second, version_ << 1 });
+        keys_.push_back({ row_[other].cross, first, second, (version_ << 1) | 1 });
+    }
+}
+
+void DeltaIndex::mergeRuns()
+{
+    while (runEnds_.size() >= 2) {
+        const std::size_t last = runEnds_.size() - 1;
+        const std::size_t begin = last >= 2 ? runEnds_[last - 2] : 0;
+        const std::size_t middle = runEnds_[last - 1];
+        const std::size_t end = runEnds_[last];
+
+        if (end - middle < middle - begin)
+            break;
+
+        std::inplace_merge(keys_.begin() + begin, keys_.begin() + middle, keys_.begin() + end);
+        runEnds_.erase(runEnds_.end() - 2);
+    }
+}
+
+void DeltaIndex::compact()
+{
+    std::size_t write = 0;
+    std::size_t begin = 0;
+
+    for (auto& end : runEnds_) {
+        for (std::size_t read = begin; read < end; read++) {
+            if (current(keys_[read]))
+                keys_[write++] = keys_[read];
+        }
+
+        begin = end;
+        end = write;
+    }
+
+    keys_.resize(write);
+
+    // the runs shrink from front to back, so merging from the back is cheap
+    while (runEnds_.size() >= 2) {
+        const std::size_t last = runEnds_.size() - 1;
+        const std::size_t merged = last >= 2 ? runEnds_[last - 2] : 0;
+        std::inplace_merge(keys_.begin() + merged, keys_.begin() + runEnds_[last - 1], keys_.end());
+        runEnds_.erase(runEnds_.end() - 2);
+    }
+}
+
+Move TwoExchangeNeighborhood::bestMove(const Solution& base, Value bound, DeltaCache& cache)
+{
+    reset(base.length());
+    Move best;
+
+    if (!(*this != std::default_sentinel))
+        return best;
+
+    // like the iterator, start with the neighbor at reset, which is not checked against the length limits
+    const std::size_t firstCut2 = cut2_;
+    if (const Value newObjective = objective(base); newObjective < bound) {
+        bound = newObjective;
+        best = current();
+    }
+
+    cache.sync(base);
+    const EdgeSlots& edges = cache.edges();
+    const Value value = base.value();
+    const std::size_t n = base.length();
+
+    for (std::size_t cut1 = 0; cut1 < n - minl_; cut1++) {
+        const ExchangeDeltas* row = cache.row(edges.slot(cut1));
+        const bool forward1 = edges.forward(cut1);
+
+        for (const auto& range : rowRanges(cut1)) {
+            const std::size_t begin = cut1 > 0 ? range.begin : std::max(range.begin, firstCut2 + 1);
+
+            for (std::size_t cut2 = begin; cut2 < range.end; cut2++) {
+                const ExchangeDeltas& entry = row[edges.slot(cut2)];
+                const Value sum = value + (edges.forward(cut2) == forward1 ? entry.same : entry.cross);
+                const Value newObjective = sum < 0 ? -sum : sum;
+
+                if (newObjective < bound) {
+                    bound = newObjective;
+                    best = { Move::Kind::TWO_EXCHANGE, cut1, cut2 };
+                }
+            }
+        }
+    }
+
+    return best;
+}
+
+Move TwoExchangeNeighborhood::bestMove(const Solution& base, Value bound, DeltaIndex& index)
+{
+    reset(base.length());
+    Move best;
+
+    if (!(*this != std::default_sentinel))
+        return best;
+
+    // like the iterator, start with the neighbor at reset, which is not checked against the length limits
+    const std::size_t firstCut2 = cut2_;
+    if (const Value newObjective = objective(base); newObjective < bound) {
+        bound = newObjective;
+        best = current();
+    }
+
+    index.sync(base);
+    const EdgeSlots& edges = index.edges();
+    const Value value = base.value();
+    const Value target = -value;
+    const auto ranges = distanceRanges();
+    bool found = false; // whether the best move comes from the index
+
+    // Accept the move of the key if it is valid and better than the best one so far.
+    // Among moves of equal objective, the one that comes first in iteration order wins, like in a scan.
+    const auto consider = [&](const DeltaIndex::Key& key)
+    {
+        if (!index.current(key))
+            return;
+
+        const std::size_t firstCut = edges.cut(key.first);
+        const std::size_t secondCut = edges.cut(key.second);
+        const auto [cut1, cut2] = std::minmax(firstCut, secondCut);
+        const std::size_t distance = cut2 - cut1;
+        const bool inRange = std::any_of(ranges.begin(), ranges.end(),
+            [distance](const CutRange& range) { return range.begin <= distance && distance < range.end; });
+        const bool cross = key.stamp & 1;
+
+        if (!inRange || (0 == cut1 && cut2 <= firstCut2) || cross != (edges.forward(cut1) != edges.forward(cut2)))
+            return;
+
+        const Value sum = value + key.delta;
+        const Value newObjective = sum < 0 ? -sum : sum;
+
+        if (newObjective < bound || (newObjective == bound && found &&
+            std::pair(cut1, cut2) < std::pair(best.cut1, best.cut2))) {
+            bound = newObjective;
+            best = { Move::Kind::TWO_EXCHANGE, cut1, cut2 };
+            found = true;
+        }
+    };
+
+    // walk outward from the target while the keys can still match the best objective
+    for (std::size_t run = 0; run < index.runs(); run++) {
+        const auto [begin, end] = index.run(run);
+        const auto middle = std::lower_bound(begin, end, DeltaIndex::Key{ target });
+
+        for (auto key = middle; key != end && key->delta - target <= bound; ++key)
+            consider(*key);
+
+        for (auto key = middle; key != begin && target - (key - 1)->delta <= bound; --key)
+            consider(*(key - 1));
+    }
+
+    return best;
+}
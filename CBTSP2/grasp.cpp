@@ -2,10 +2,16 @@ module;
 
 #include <memory>
 #include <utility>
+#include <optional>
+#include <random>
+#include <cstdint>
+#include <algorithm>
 #include <cassert>
 
 module grasp;
 
+import util;
+
 Grasp::Grasp(std::unique_ptr<Construction> construction,
     std::unique_ptr<LocalSearch> improvement, int iterations) noexcept
     : construction_(move(construction)), improvement_(move(improvement)), iterations_(iterations)
@@ -13,8 +19,23 @@ Grasp::Grasp(std::unique_ptr<Construction> construction,
     assert(iterations > 0);
 }
 
+Grasp::Grasp(const GraspWorkerFactory& buildWorker, int iterations, int threads,
+    const std::shared_ptr<Random>& random)
+    : iterations_(iterations), random_(random)
+{
+    assert(iterations > 0);
+    assert(threads > 0);
+    assert(random);
+
+    for (int i = 0; i < std::min(threads, iterations); i++)
+        workers_.push_back(buildWorker());
+}
+
 Solution Grasp::search(const Problem& problem)
 {
+    if (!workers_.empty())
+        return searchParallel(problem);
+
     Solution solution = improvement_->search(construction_->construct(problem));
 
     for (int i = 1; i < iterations_; i++) {
@@ -25,4 +46,46 @@ Solution Grasp::search(const Problem& problem)
     }
 
     return solution;
-}
\ No newline at end of file
+}
+
+Solution Grasp::searchParallel(const Problem& problem)
+{
+    //! Best solution of a thread with the iteration which found it.
+    struct Incumbent
+    {
+        std::optional<Solution> solution;
+        std::size_t iteration = 0;
+    };
+
+    const auto seed = (*random_)();
+    std::vector<Incumbent> incumbents(workers_.size());
+
+    parallelFor(iterations_, static_cast<int>(workers_.size()), [&](int thread, std::size_t i)
+        {
+            auto& worker = workers_[thread];
+            auto seeds = std::seed_seq{ static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(i) };
+            worker.random->seed(seeds);
+
+            Solution candidate = worker.improvement->search(worker.construction->construct(problem));
+
+            // iterations come in increasing order, so the earlier one stays on ties
+            auto& incumbent = incumbents[thread];
+            if (!incumbent.solution || candidate < *incumbent.solution) {
+                incumbent.solution = std::move(candidate);
+                incumbent.iteration = i;
+            }
+        });
+
+    const Incumbent* best = nullptr;
+    for (const auto& incumbent : incumbents) {
+        if (!incumbent.solution)
+            continue;
+
+        if (!best || *incumbent.solution < *best->solution ||
+            (!(*best->solution < *incumbent.solution) && incumbent.iteration < best->iteration))
+            best = &incumbent;
+    }
+
+    assert(best);
+    return *best->solution;
+}
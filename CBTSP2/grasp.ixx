@@ -9,6 +9,8 @@
 module;
 
 #include <memory>
+#include <vector>
+#include <functional>
 
 export module grasp;
 
@@ -16,8 +18,29 @@ import cbtsp;
 import construction;
 import local;
 
+/**
+ * The heuristics with which one thread of a parallel GRASP runs its iterations.
+ */
+export struct GraspWorker
+{
+    std::unique_ptr<Construction> construction; //!< construction heuristic, randomized by the generator
+    std::unique_ptr<LocalSearch> improvement; //!< improvement heuristic a.k.a. local search
+    std::shared_ptr<Random> random; //!< random number generator of the heuristics
+};
+
+/**
+ * Creates the heuristics for one thread of a parallel GRASP.
+ */
+export using GraspWorkerFactory = std::function<GraspWorker()>;
+
 /**
  * GRASP implementation.
+ *
+ * In the parallel mode, every thread owns its own heuristics and takes iterations from
+ * a shared counter. Each iteration seeds the random number generator of its thread from a
+ * search seed and the iteration number. Each thread keeps the best solution of its own
+ * iterations, and these are merged at the end, with ties going to the earlier iteration.
+ * The result therefore does not depend on the number of threads.
  */
 export class Grasp : public Search
 {
@@ -34,6 +57,17 @@ public:
     explicit Grasp(std::unique_ptr<Construction> construction,
         std::unique_ptr<LocalSearch> improvement, int iterations) noexcept;
 
+    /**
+     * Construct the parallel search.
+     *
+     * @param buildWorker: factory for the heuristics of one thread
+     * @param iterations: number of random constructions to consider, over all threads
+     * @param threads: number of threads
+     * @param random: random number generator for the search seeds
+     */
+    explicit Grasp(const GraspWorkerFactory& buildWorker, int iterations, int threads,
+        const std::shared_ptr<Random>& random);
+
     /**
      * Execute the GRASP search scheme for the given problem.
      *
@@ -47,5 +81,12 @@ private:
     std::unique_ptr<Construction> construction_;
     std::unique_ptr<LocalSearch> improvement_;
     int iterations_;
+    std::vector<GraspWorker> workers_; //!< heuristics of each thread, empty if serial
+    std::shared_ptr<Random> random_; //!< parallel mode: random number generator for the search seeds
+
+    /**
+     * Execute the iterations on multiple threads.
+     */
+    Solution searchParallel(const Problem& problem);
 
 };
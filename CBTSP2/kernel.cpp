@@ -0,0 +1,174 @@
+module;
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <bit>
+
+// AVX2 code paths are compiled for x86 targets and selected at run time.
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#define CBTSP_AVX2
+#define CBTSP_TARGET_AVX2
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define CBTSP_AVX2
+#define CBTSP_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+module local;
+
+std::pair<std::size_t, Value> minAbsSumPortable(Value base,
+    const Value* a, const Value* b, const Value* c, std::size_t count) noexcept
+{
+    auto best = std::pair(count, std::numeric_limits<Value>::max());
+
+    for (std::size_t i = 0; i < count; i++) {
+        const Value sum = base + a[i] + b[i] - c[i];
+        const Value objective = sum < 0 ? -sum : sum;
+        if (objective < best.second)
+            best = { i, objective };
+    }
+
+    return best;
+}
+
+std::size_t firstAbsSumBelowPortable(Value base,
+    const Value* a, const Value* b, const Value* c, std::size_t count, Value bound) noexcept
+{
+    for (std::size_t i = 0; i < count; i++) {
+        const Value sum = base + a[i] + b[i] - c[i];
+        if ((sum < 0 ? -sum : sum) < bound)
+            return i;
+    }
+
+    return count;
+}
+
+#ifdef CBTSP_AVX2
+
+/**
+ * Determine whether the processor and the operating system support AVX2.
+ */
+bool detectAvx2() noexcept
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+
+    __cpuid(info, 1);
+    const bool osxsave = info[2] & (1 << 27);
+    const bool avx = info[2] & (1 << 28);
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+        return false;
+
+    __cpuidex(info, 7, 0);
+    return info[1] & (1 << 5);
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+// Load four consecutive sums base + a[i] + b[i] - c[i] and take their absolute values.
+CBTSP_TARGET_AVX2
+inline __m256i absSum4(__m256i base, const Value* a, const Value* b, const Value* c) noexcept
+{
+    __m256i sum = _mm256_add_epi64(base, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a)));
+    sum = _mm256_add_epi64(sum, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b)));
+    sum = _mm256_sub_epi64(sum, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(c)));
+
+    const __m256i negative = _mm256_cmpgt_epi64(_mm256_setzero_si256(), sum);
+    return _mm256_sub_epi64(_mm256_xor_si256(sum, negative), negative);
+}
+
+CBTSP_TARGET_AVX2
+std::pair<std::size_t, Value> minAbsSumAvx2(Value base,
+    const Value* a, const Value* b, const Value* c, std::size_t count) noexcept
+{
+    const __m256i baseLanes = _mm256_set1_epi64x(base);
+    const __m256i four = _mm256_set1_epi64x(4);
+    __m256i index = _mm256_setr_epi64x(0, 1, 2, 3);
+    __m256i bestIndex = _mm256_setzero_si256();
+    __m256i best = _mm256_set1_epi64x(std::numeric_limits<Value>::max());
+
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m256i objective = absSum4(baseLanes, a + i, b + i, c + i);
+        const __m256i less = _mm256_cmpgt_epi64(best, objective);
+        best = _mm256_blendv_epi8(best, objective, less);
+        bestIndex = _mm256_blendv_epi8(bestIndex, index, less);
+        index = _mm256_add_epi64(index, four);
+    }
+
+    auto result = std::pair(count, std::numeric_limits<Value>::max());
+
+    if (i > 0) {
+        alignas(32) std::int64_t laneBest[4];
+        alignas(32) std::int64_t laneIndex[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(laneBest), best);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(laneIndex), bestIndex);
+
+        // each lane holds its first minimum; among equal lanes, the lowest index wins
+        for (int lane = 0; lane < 4; lane++) {
+            const auto laneResult = std::pair(static_cast<std::size_t>(laneIndex[lane]), laneBest[lane]);
+            if (laneResult.second < result.second ||
+                (laneResult.second == result.second && laneResult.first < result.first))
+                result = laneResult;
+        }
+    }
+
+    // the remaining elements come after all vector elements
+    const auto tail = minAbsSumPortable(base, a + i, b + i, c + i, count - i);
+    if (tail.second < result.second)
+        result = { i + tail.first, tail.second };
+
+    return result;
+}
+
+CBTSP_TARGET_AVX2
+std::size_t firstAbsSumBelowAvx2(Value base,
+    const Value* a, const Value* b, const Value* c, std::size_t count, Value bound) noexcept
+{
+    const __m256i baseLanes = _mm256_set1_epi64x(base);
+    const __m256i boundLanes = _mm256_set1_epi64x(bound);
+
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m256i below = _mm256_cmpgt_epi64(boundLanes, absSum4(baseLanes, a + i, b + i, c + i));
+        const unsigned mask = static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(below)));
+        if (mask)
+            return i + std::countr_zero(mask);
+    }
+
+    return i + firstAbsSumBelowPortable(base, a + i, b + i, c + i, count - i, bound);
+}
+
+const bool haveAvx2 = detectAvx2();
+
+#endif
+
+std::pair<std::size_t, Value> minAbsSum(Value base,
+    const Value* a, const Value* b, const Value* c, std::size_t count) noexcept
+{
+#ifdef CBTSP_AVX2
+    if (haveAvx2)
+        return minAbsSumAvx2(base, a, b, c, count);
+#endif
+
+    return minAbsSumPortable(base, a, b, c, count);
+}
+
+std::size_t firstAbsSumBelow(Value base,
+    const Value* a, const Value* b, const Value* c, std::size_t count, Value bound) noexcept
+{
+#ifdef CBTSP_AVX2
+    if (haveAvx2)
+        return firstAbsSumBelowAvx2(base, a, b, c, count, bound);
+#endif
+
+    return firstAbsSumBelowPortable(base, a, b, c, count, bound);
+}
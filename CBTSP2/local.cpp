@@ -2,17 +2,76 @@ module;
 
 #include <limits>
 #include <memory>
+#include <vector>
+#include <algorithm>
 #include <utility>
 #include <random>
 #include <cassert>
 
 module local;
 
+import util;
+
+void Move::apply(Solution& solution) const
+{
+    switch (kind) {
+
+    case Kind::NONE:
+        break;
+
+    case Kind::TWO_EXCHANGE:
+        solution.twoOpt(cut1, cut2);
+        break;
+
+    default:
+        assert(0);
+
+    }
+}
+
 void Neighborhood::reset(std::size_t vertices) noexcept
 {
     vertices_ = vertices;
 }
 
+void Neighborhood::seek(std::size_t index)
+{
+    reset(vertices_);
+
+    for (std::size_t i = 0; i < index; i++)
+        ++*this;
+}
+
+void Neighborhood::apply(Solution& solution) const
+{
+    current().apply(solution);
+}
+
+Move Neighborhood::bestMove(const Solution& base, Value bound)
+{
+    Move best;
+
+    for (reset(base.length()); *this != std::default_sentinel; ++*this) {
+        const Value newObjective = objective(base);
+        if (newObjective < bound) {
+            bound = newObjective;
+            best = current();
+        }
+    }
+
+    return best;
+}
+
+Move Neighborhood::firstMove(const Solution& base, Value bound)
+{
+    for (reset(base.length()); *this != std::default_sentinel; ++*this) {
+        if (objective(base) < bound)
+            return current();
+    }
+
+    return {};
+}
+
 Solution Neighborhood::applyCopy(const Solution& base) const
 {
     Solution neighbor{ base };
@@ -21,7 +80,7 @@ Solution Neighborhood::applyCopy(const Solution& base) const
 }
 
 TwoExchangeNeighborhood::TwoExchangeNeighborhood(std::size_t minl, std::size_t maxl) noexcept
-    : Neighborhood(), minl_(minl), maxl_(maxl), cut1_(0), cut2_(minl)
+    : Neighborhood(), minl_(minl), maxl_(maxl), cut1_(0), cut2_(minl), resetCut2_(minl)
 {
     assert(minl >= 2);
     assert(maxl >= minl);
@@ -37,6 +96,7 @@ void TwoExchangeNeighborhood::reset(std::size_t vertices) noexcept
     Neighborhood::reset(vertices);
     cut1_ = 0;
     cut2_ = minl_;
+    resetCut2_ = minl_;
 }
 
 std::size_t TwoExchangeNeighborhood::size() const noexcept
@@ -81,14 +141,455 @@ TwoExchangeNeighborhood& TwoExchangeNeighborhood::operator++()
     return *this;
 }
 
+void TwoExchangeNeighborhood::seek(std::size_t index)
+{
+    cut1_ = 0;
+    cut2_ = resetCut2_;
+
+    if (0 == index)
+        return;
+
+    // like the iterator, continue after the neighbor at reset, which is not checked against the length limits
+    std::size_t skipped = 0; // valid neighbors in the first row up to the one at reset
+    for (const auto& range : rowRanges(0))
+        skipped += std::min(range.end, resetCut2_ + 1) - std::min(range.begin, resetCut2_ + 1);
+
+    index += skipped - 1;
+
+    const std::size_t rows = vertices_ - minl_;
+    if (index >= countBefore(rows)) {
+        // exhausted, like the iterator
+        cut1_ = rows;
+        cut2_ = vertices_;
+        return;
+    }
+
+    // find the row which contains the neighbor; countBefore(low) <= index < countBefore(high)
+    std::size_t low = 0;
+    std::size_t high = rows;
+
+    while (high - low > 1) {
+        const std::size_t middle = low + (high - low) / 2;
+        if (countBefore(middle) <= index)
+            low = middle;
+        else
+            high = middle;
+    }
+
+    cut1_ = low;
+    index -= countBefore(low);
+
+    for (const auto& range : rowRanges(cut1_)) {
+        if (index < range.end - range.begin) {
+            cut2_ = range.begin + index;
+            return;
+        }
+
+        index -= range.end - range.begin;
+    }
+
+    assert(0);
+}
+
 Value TwoExchangeNeighborhood::objective(const Solution& base) const noexcept
 {
     return std::abs(base.twoOptValue(cut1_, cut2_));
 }
 
-void TwoExchangeNeighborhood::apply(Solution& solution) const
+Move TwoExchangeNeighborhood::current() const noexcept
+{
+    return { Move::Kind::TWO_EXCHANGE, cut1_, cut2_ };
+}
+
+// Set the row entries at the tour positions of the neighbors of the vertex to their edge values.
+void scatterRow(std::vector<Value>& row, const Problem& problem, Vertex vertex,
+    const std::vector<std::size_t>& positions) noexcept
+{
+    const auto neighbors = problem.neighbors(vertex);
+    const auto values = problem.neighborValues(vertex);
+
+    for (std::size_t i = 0; i < neighbors.size(); i++)
+        row[positions[neighbors[i]]] = values[i];
+}
+
+// Reset the row entries at the tour positions of the neighbors of the vertex to big-M.
+void clearRow(std::vector<Value>& row, const Problem& problem, Vertex vertex,
+    const std::vector<std::size_t>& positions) noexcept
+{
+    for (const Vertex neighbor : problem.neighbors(vertex))
+        row[positions[neighbor]] = problem.bigM();
+}
+
+Move TwoExchangeNeighborhood::bestMove(const Solution& base, Value bound)
+{
+    reset(base.length());
+    Move best;
+
+    if (!(*this != std::default_sentinel))
+        return best;
+
+    // like the iterator, start with the neighbor at reset, which is not checked against the length limits
+    const std::size_t firstCut2 = cut2_;
+    if (const Value newObjective = objective(base); newObjective < bound) {
+        bound = newObjective;
+        best = current();
+    }
+
+    prepareScan(base);
+    const auto [move, newObjective] = bestMoveInRows(base, 0, base.length() - minl_, firstCut2, bound,
+        prevRow_, nextRow_);
+    return Move::Kind::NONE == move.kind ? best : move;
+}
+
+Move TwoExchangeNeighborhood::bestMove(const Solution& base, Value bound, ThreadPool& pool)
+{
+    const int threads = pool.threads();
+    const std::size_t n = base.length();
+    if (threads < 2 || n < parallelMinVertices)
+        return bestMove(base, bound);
+
+    reset(n);
+    Move best;
+
+    if (!(*this != std::default_sentinel))
+        return best;
+
+    const std::size_t firstCut2 = cut2_;
+    if (const Value newObjective = objective(base); newObjective < bound) {
+        bound = newObjective;
+        best = current();
+    }
+
+    // prepareScan brings the vertex vector up to date, so the threads only read the buffers and the tour
+    prepareScan(base);
+
+    // a completed scan leaves its rows at big-M, but an aborted one may leave any entry set
+    const Value bigM = base.problem().bigM();
+    if (!threadRowsClean_ || threadRowsBigM_ != bigM)
+        threadRows_.clear();
+
+    threadRowsClean_ = false;
+    threadRowsBigM_ = bigM;
+    threadRows_.resize(2 * (threads - 1));
+    for (auto& row : threadRows_) {
+        if (row.size() != n)
+            row.assign(n, bigM);
+    }
+
+    // cut the triangle of rows into chunks with about the same number of neighbors
+    const std::size_t rows = n - minl_;
+    const std::size_t chunks = std::min(rows, 4 * static_cast<std::size_t>(threads));
+    const std::size_t total = countBefore(rows);
+    std::vector<std::size_t> chunkEnds(chunks, rows);
+
+    for (std::size_t k = 0; k + 1 < chunks; k++) {
+        const std::size_t target = total * (k + 1) / chunks;
+        std::size_t low = k > 0 ? chunkEnds[k - 1] : 0;
+        std::size_t high = rows;
+
+        // first row r with countBefore(r) >= target
+        while (low < high) {
+            const std::size_t middle = low + (high - low) / 2;
+            if (countBefore(middle) < target)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+
+        chunkEnds[k] = low;
+    }
+
+    std::vector<std::pair<Move, Value>> results(chunks);
+    pool.parallelFor(chunks, [&](int thread, std::size_t k)
+        {
+            auto& prevRow = 0 == thread ? prevRow_ : threadRows_[2 * (thread - 1)];
+            auto& nextRow = 0 == thread ? nextRow_ : threadRows_[2 * thread - 1];
+            const std::size_t begin = k > 0 ? chunkEnds[k - 1] : 0;
+            results[k] = bestMoveInRows(base, begin, chunkEnds[k], firstCut2, bound, prevRow, nextRow);
+        });
+
+    threadRowsClean_ = true;
+
+    // the earlier chunk wins ties, like in the serial scan
+    for (const auto& [move, newObjective] : results) {
+        if (Move::Kind::NONE != move.kind && newObjective < bound) {
+            bound = newObjective;
+            best = move;
+        }
+    }
+
+    return best;
+}
+
+std::pair<Move, Value> TwoExchangeNeighborhood::bestMoveInRows(const Solution& base,
+    std::size_t rowBegin, std::size_t rowEnd, std::size_t firstCut2, Value bound,
+    std::vector<Value>& prevRow, std::vector<Value>& nextRow) const
+{
+    const auto& tour = base.vertices();
+    const Problem& problem = base.problem();
+    const std::size_t n = tour.size();
+    Move best;
+
+    for (std::size_t cut1 = rowBegin; cut1 < rowEnd; cut1++) {
+        const Vertex prev1 = tour[(cut1 + n - 1) % n];
+        const Vertex next1 = tour[cut1];
+        const Value rowBase = base.value() - edges_[cut1];
+        scatterRow(prevRow, problem, prev1, positions_);
+        scatterRow(nextRow, problem, next1, positions_);
+
+        for (const auto& range : rowRanges(cut1)) {
+            const std::size_t begin = cut1 > 0 ? range.begin : std::max(range.begin, firstCut2 + 1);
+            if (range.end <= begin)
+                continue;
+
+            const std::size_t count = range.end - begin;
+            const auto [index, newObjective] = minAbsSum(rowBase, &prevRow[begin - 1],
+                &nextRow[begin], &edges_[begin], count);
+
+            if (newObjective < bound) {
+                bound = newObjective;
+                best = { Move::Kind::TWO_EXCHANGE, cut1, begin + index };
+            }
+        }
+
+        clearRow(prevRow, problem, prev1, positions_);
+        clearRow(nextRow, problem, next1, positions_);
+    }
+
+    return { best, bound };
+}
+
+Move TwoExchangeNeighborhood::firstMove(const Solution& base, Value bound)
+{
+    reset(base.length());
+
+    if (!(*this != std::default_sentinel))
+        return {};
+
+    // like the iterator, start with the neighbor at reset, which is not checked against the length limits
+    const std::size_t firstCut2 = cut2_;
+    if (objective(base) < bound)
+        return current();
+
+    prepareScan(base);
+    const auto& tour = base.vertices();
+    const Problem& problem = base.problem();
+    const std::size_t n = tour.size();
+
+    for (std::size_t cut1 = 0; cut1 < n - minl_; cut1++) {
+        const Vertex prev1 = tour[(cut1 + n - 1) % n];
+        const Vertex next1 = tour[cut1];
+        const Value rowBase = base.value() - edges_[cut1];
+        scatterRow(prevRow_, problem, prev1, positions_);
+        scatterRow(nextRow_, problem, next1, positions_);
+
+        for (const auto& range : rowRanges(cut1)) {
+            const std::size_t begin = cut1 > 0 ? range.begin : std::max(range.begin, firstCut2 + 1);
+            if (range.end <= begin)
+                continue;
+
+            const std::size_t count = range.end - begin;
+            const std::size_t index = firstAbsSumBelow(rowBase, &prevRow_[begin - 1],
+                &nextRow_[begin], &edges_[begin], count, bound);
+
+            if (index < count)
+                return { Move::Kind::TWO_EXCHANGE, cut1, begin + index };
+        }
+
+        clearRow(prevRow_, problem, prev1, positions_);
+        clearRow(nextRow_, problem, next1, positions_);
+    }
+
+    return {};
+}
+
+void TwoExchangeNeighborhood::prepareScan(const Solution& base)
+{
+    const auto& tour = base.vertices();
+    const Problem& problem = base.problem();
+    const std::size_t n = tour.size();
+
+    positions_.resize(problem.vertices());
+    edges_.resize(n);
+    prevRow_.assign(n, problem.bigM());
+    nextRow_.assign(n, problem.bigM());
+
+    for (std::size_t pos = 0; pos < n; pos++) {
+        positions_[tour[pos]] = pos;
+        edges_[pos] = problem.value(tour[(pos + n - 1) % n], tour[pos]);
+    }
+}
+
+std::array<TwoExchangeNeighborhood::CutRange, 2> TwoExchangeNeighborhood::distanceRanges() const noexcept
+{
+    assert(minl_ < vertices_);
+
+    // valid distances d between the cuts have min(d, vertices - d) in [minl, maxl]
+    const std::size_t shortEnd = std::min(maxl_, vertices_ - minl_) + 1;
+    const std::size_t longBegin = maxl_ >= vertices_ ? minl_ : std::max(minl_, vertices_ - maxl_);
+    const std::size_t longEnd = vertices_ - minl_ + 1;
+
+    auto shortRange = CutRange{ minl_, std::max(shortEnd, minl_) };
+    auto longRange = CutRange{ longBegin, std::max(longEnd, longBegin) };
+
+    // both ranges share their start, or the long range continues the short range
+    if (longRange.begin <= shortRange.end) {
+        shortRange.end = std::max(shortRange.end, longRange.end);
+        longRange.begin = longRange.end = shortRange.end;
+    }
+
+    return { shortRange, longRange };
+}
+
+std::array<TwoExchangeNeighborhood::CutRange, 2> TwoExchangeNeighborhood::rowRanges(std::size_t cut1) const noexcept
+{
+    auto ranges = distanceRanges();
+    const std::size_t endDistance = vertices_ - cut1; // distance to past the last position
+
+    for (auto& range : ranges) {
+        range.begin = cut1 + std::min(range.begin, endDistance);
+        range.end = cut1 + std::min(range.end, endDistance);
+    }
+
+    return ranges;
+}
+
+std::size_t TwoExchangeNeighborhood::countBefore(std::size_t cut1) const noexcept
+{
+    std::size_t count = 0;
+
+    // Row c holds the distances [begin, end) clipped to below vertices - c: all of them
+    // up to row vertices - end, then one less in every row until none in row vertices - begin.
+    for (const auto& range : distanceRanges()) {
+        if (range.end <= range.begin)
+            continue;
+
+        const std::size_t fullRows = std::min(cut1, vertices_ - range.end + 1);
+        const std::size_t partialEnd = std::min(cut1, vertices_ - range.begin);
+        count += fullRows * (range.end - range.begin);
+
+        if (partialEnd > fullRows) {
+            const std::size_t partialRows = partialEnd - fullRows;
+            count += partialRows * (vertices_ - range.begin) - (fullRows + partialEnd - 1) * partialRows / 2;
+        }
+    }
+
+    return count;
+}
+
+void TwoExchangeNeighborhood::activateAll(const Solution& base)
 {
-    solution.twoOpt(cut1_, cut2_);
+    reset(base.length());
+    const auto& tour = base.vertices();
+
+    queue_ = tour;
+    active_.assign(base.problem().vertices(), true);
+    queueHead_ = 0;
+    queueSize_ = tour.size();
+    sweepImproved_ = false;
+}
+
+Move TwoExchangeNeighborhood::activeMove(const Solution& base, Value bound)
+{
+    prepareScan(base);
+    const auto& tour = base.vertices();
+    const std::size_t n = tour.size();
+
+    for (;;) {
+        if (0 == queueSize_) {
+            // a move elsewhere changes the total value, which can make any vertex improvable again
+            if (!sweepImproved_)
+                return {};
+
+            for (std::size_t pos = 0; pos < n; pos++)
+                activate(tour[pos]);
+
+            sweepImproved_ = false;
+        }
+
+        const Vertex vertex = queue_[queueHead_];
+        queueHead_ = (queueHead_ + 1) % queue_.size();
+        queueSize_--;
+        active_[vertex] = false;
+
+        // exchange either the edge leading to the vertex or the edge leaving it
+        const std::size_t pos = positions_[vertex];
+        auto [move, objective] = bestMoveAt(base, pos, bound);
+        const auto [leavingMove, leavingObjective] = bestMoveAt(base, (pos + 1) % n, bound);
+
+        if (leavingObjective < objective)
+            move = leavingMove;
+
+        if (Move::Kind::NONE != move.kind) {
+            activate(tour[(move.cut1 + n - 1) % n]);
+            activate(tour[move.cut1]);
+            activate(tour[move.cut2 - 1]);
+            activate(tour[move.cut2]);
+            sweepImproved_ = true;
+            return move;
+        }
+    }
+}
+
+std::pair<Move, Value> TwoExchangeNeighborhood::bestMoveAt(const Solution& base, std::size_t cut, Value bound)
+{
+    const auto& tour = base.vertices();
+    const Problem& problem = base.problem();
+    const std::size_t n = tour.size();
+    const Vertex prev = tour[(cut + n - 1) % n];
+    const Vertex next = tour[cut];
+    const Value rowBase = base.value() - edges_[cut];
+    auto best = std::pair(Move{}, bound);
+
+    // the row buffers are symmetric: the objective for the other cut is the same on either side
+    const auto consider = [&](std::size_t begin, std::size_t end)
+    {
+        if (begin == 0 && end > 0) {
+            // the cut at position 0 follows the last position, outside of the buffers
+            if (const Value objective = std::abs(base.twoOptValue(0, cut)); objective < best.second)
+                best = { { Move::Kind::TWO_EXCHANGE, 0, cut }, objective };
+            begin = 1;
+        }
+
+        if (end <= begin)
+            return;
+
+        const std::size_t count = end - begin;
+        const auto [index, objective] = minAbsSum(rowBase, &prevRow_[begin - 1],
+            &nextRow_[begin], &edges_[begin], count);
+
+        if (objective < best.second) {
+            const std::size_t other = begin + index;
+            best = { { Move::Kind::TWO_EXCHANGE, std::min(cut, other), std::max(cut, other) }, objective };
+        }
+    };
+
+    scatterRow(prevRow_, problem, prev, positions_);
+    scatterRow(nextRow_, problem, next, positions_);
+
+    for (const auto& range : distanceRanges()) {
+        // other cuts before this one
+        if (range.begin <= cut)
+            consider(cut + 1 - std::min(range.end, cut + 1), cut + 1 - range.begin);
+
+        // other cuts after this one
+        consider(cut + std::min(range.begin, n - cut), cut + std::min(range.end, n - cut));
+    }
+
+    clearRow(prevRow_, problem, prev, positions_);
+    clearRow(nextRow_, problem, next, positions_);
+
+    return best;
+}
+
+void TwoExchangeNeighborhood::activate(Vertex vertex) noexcept
+{
+    if (active_[vertex])
+        return;
+
+    queue_[(queueHead_ + queueSize_) % queue_.size()] = vertex;
+    queueSize_++;
+    active_[vertex] = true;
 }
 
 bool TwoExchangeNeighborhood::operator!=(std::default_sentinel_t) const noexcept
@@ -133,43 +634,30 @@ Step::Step(std::unique_ptr<Neighborhood> neighborhood) noexcept
 {
 }
 
-FirstImprovement::FirstImprovement(std::unique_ptr<Neighborhood> neighborhood) noexcept
-    : Step(move(neighborhood))
+void Step::restart() noexcept
 {
 }
 
-void FirstImprovement::step(Solution& base)
+DontLookImprovement::DontLookImprovement(std::unique_ptr<TwoExchangeNeighborhood> neighborhood) noexcept
+    : Step(std::move(neighborhood)), restarted_(true)
 {
-    auto baseObjective = base.objective();
-
-    for (neighborhood_->reset(base.length()); *neighborhood_ != std::default_sentinel; ++*neighborhood_) {
-        if (neighborhood_->objective(base) < baseObjective) {
-            neighborhood_->apply(base);
-            return;
-        }
-    }
 }
 
-BestImprovement::BestImprovement(std::unique_ptr<Neighborhood> neighborhood) noexcept
-    : Step(move(neighborhood))
+void DontLookImprovement::restart() noexcept
 {
+    restarted_ = true;
 }
 
-void BestImprovement::step(Solution& base)
+void DontLookImprovement::step(Solution& base)
 {
-    auto bestObjective = base.objective();
-    std::unique_ptr<Neighborhood> bestNeighbor = nullptr;
+    auto& neighborhood = static_cast<TwoExchangeNeighborhood&>(*neighborhood_);
 
-    for (neighborhood_->reset(base.length()); *neighborhood_ != std::default_sentinel; ++*neighborhood_) {
-        const Value newObjective = neighborhood_->objective(base);
-        if (newObjective < bestObjective) {
-            bestObjective = newObjective;
-            bestNeighbor = neighborhood_->clone();
-        }
+    if (restarted_) {
+        neighborhood.activateAll(base);
+        restarted_ = false;
     }
 
-    if(bestNeighbor)
-        bestNeighbor->apply(base);
+    neighborhood.activeMove(base, base.objective()).apply(base);
 }
 
 StepRandom::StepRandom(std::unique_ptr<Neighborhood> neighborhood,
@@ -181,23 +669,22 @@ StepRandom::StepRandom(std::unique_ptr<Neighborhood> neighborhood,
 
 void StepRandom::step(Solution& base)
 {
-    const auto distribution = std::uniform_int_distribution{ 0ull, neighborhood_->size() - 1 };
-    const std::size_t choice = distribution(*random_);
     neighborhood_->reset(base.length());
-
-    for (std::size_t i = 0; i < choice; i++)
-        ++*neighborhood_;
-
-    neighborhood_->apply(base);
+    const auto distribution = std::uniform_int_distribution{ 0ull, neighborhood_->size() - 1 };
+    neighborhood_->seek(distribution(*random_));
+    neighborhood_->current().apply(base);
 }
 
-LocalSearch::LocalSearch(std::unique_ptr<Step> step) noexcept
-    : step_(move(step))
+LocalSearch::LocalSearch(std::unique_ptr<Step> step, TourLayout layout) noexcept
+    : step_(move(step)), layout_(layout)
 {
 }
 
 Solution LocalSearch::search(Solution solution)
 {
+    const auto originalLayout = solution.layout();
+    solution.setLayout(layout_);
+    step_->restart();
     auto best = solution.objective();
 
     for (;;) {
@@ -211,13 +698,15 @@ Solution LocalSearch::search(Solution solution)
             best = objective;
     }
 
+    solution.setLayout(originalLayout);
     return solution;
 }
 
 StandaloneLocalSearch::StandaloneLocalSearch(
     std::unique_ptr<Construction> construction,
-    std::unique_ptr<Step> step) noexcept
-    : construction_(move(construction)), local_(move(step))
+    std::unique_ptr<Step> step,
+    TourLayout layout) noexcept
+    : construction_(move(construction)), local_(move(step), layout)
 {
 }
 
@@ -7,13 +7,66 @@
 module;
 
 #include <iterator>
+#include <concepts>
 #include <memory>
 #include <random>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <array>
+#include <cstdint>
 
 export module local;
 
 import cbtsp;
 import construction;
+import util;
+
+/**
+ * Find the smallest of the sums |base + a[i] + b[i] - c[i]| for i in [0, count).
+ *
+ * This is the kernel for evaluating a whole row of two-exchange neighbors at once.
+ * It uses AVX2 if the processor supports it.
+ *
+ * @return: the first index of the minimum and the minimum, or count if count is 0
+ */
+export std::pair<std::size_t, Value> minAbsSum(Value base,
+    const Value* a, const Value* b, const Value* c, std::size_t count) noexcept;
+
+/**
+ * Find the first of the sums |base + a[i] + b[i] - c[i]| for i in [0, count) which is below the bound.
+ *
+ * @return: the first index of a sum below the bound, or count if there is none
+ */
+export std::size_t firstAbsSumBelow(Value base,
+    const Value* a, const Value* b, const Value* c, std::size_t count, Value bound) noexcept;
+
+/**
+ * Value-type descriptor of one neighbor relative to its base solution.
+ *
+ * A Move can be recorded while scanning a neighborhood, compared and
+ * applied later without keeping a copy of the neighborhood iterator.
+ */
+export struct Move
+{
+    //! The type of operation which produces the neighbor.
+    enum class Kind : unsigned char { NONE, TWO_EXCHANGE };
+
+    Kind kind = Kind::NONE; //!< operation, or NONE for no change
+    std::size_t cut1 = 0; //!< first edge to exchange is before vertex at this position
+    std::size_t cut2 = 0; //!< second edge to exchange is before vertex at this position
+
+    /**
+     * Change the base solution object into the described neighbor.
+     *
+     * @param solution: base solution to modify
+     */
+    void apply(Solution& solution) const;
+
+    bool operator==(const Move& rhs) const noexcept = default;
+};
+
+static_assert(std::is_trivially_copyable_v<Move>);
 
 /**
  * Base for neighborhood implementations.
@@ -59,6 +112,15 @@ public:
      */
     virtual Neighborhood& operator++() = 0;
 
+    /**
+     * Go to the neighbor at the given index in iteration order since the last reset,
+     * as if the iterator was advanced `index` times from there.
+     * The default implementation resets the iterator and advances it.
+     *
+     * @param index: number of neighbors before the target neighbor in iteration order
+     */
+    virtual void seek(std::size_t index);
+
     /**
      * Compute the objective value for the currently indicated neighbor.
      *
@@ -67,13 +129,39 @@ public:
      */
     virtual Value objective(const Solution& base) const noexcept = 0;
 
+    /**
+     * Describe the currently indicated neighbor as a Move.
+     */
+    virtual Move current() const noexcept = 0;
+
+    /**
+     * Scan the neighborhood of the base solution for the neighbor with the best objective.
+     * Of several equally good neighbors, the first in iteration order is chosen.
+     * This leaves the iterator in an unspecified state.
+     *
+     * @param base: base solution
+     * @param bound: only neighbors with an objective below this value are accepted
+     * @return: the best neighbor, or a NONE move if no neighbor is below the bound
+     */
+    virtual Move bestMove(const Solution& base, Value bound);
+
+    /**
+     * Scan the neighborhood of the base solution for the first neighbor below the bound.
+     * This leaves the iterator in an unspecified state.
+     *
+     * @param base: base solution
+     * @param bound: only neighbors with an objective below this value are accepted
+     * @return: the first such neighbor, or a NONE move if no neighbor is below the bound
+     */
+    virtual Move firstMove(const Solution& base, Value bound);
+
     /**
      * Change the base solution object into its neighbor according to
      * the current state of the neighborhood iterator.
      *
      * @param solution: base solution to modify
      */
-    virtual void apply(Solution& solution) const = 0;
+    void apply(Solution& solution) const;
 
     /**
      * Produce a solution object that is the neighbor of the given base
@@ -102,6 +190,274 @@ protected:
 
 };
 
+/**
+ * The value changes for the two ways to reconnect the endpoints of two exchanged edges.
+ */
+export struct ExchangeDeltas
+{
+    Value same; //!< connect the first ends and the second ends of both edges
+    Value cross; //!< connect the first end of each edge to the second end of the other
+};
+
+/**
+ * Tracks the edges of a tour across two-exchange moves.
+ *
+ * Every tour edge occupies a slot. A two-exchange move takes two edges out of
+ * the tour and puts the new edges into their slots; all other edges keep their
+ * slots, even though the move reverses the order of some of them. Which way
+ * of reconnecting two edges is the valid two-exchange depends on the relative
+ * orientation of the edges in the tour, which changes with every reversal, but
+ * the value changes of a pair of slots only change when one of its edges is exchanged.
+ */
+export class EdgeSlots
+{
+
+public:
+
+    //! How the edges changed in the last synchronization.
+    enum class Change
+    {
+        NONE, //!< all edges remain in their slots
+        MOVE, //!< the expected move replaced the edges in the `changed()` slots
+        ALL //!< all edges were assigned new slots
+    };
+
+    /**
+     * Bring the slots up to date for the given solution.
+     *
+     * If the solution is the result of the last expected move, only the
+     * exchanged edges change. Otherwise, the slots are assigned from scratch.
+     */
+    Change sync(const Solution& base);
+
+    /**
+     * Announce that the given move is about to be applied to the synchronized solution.
+     */
+    void expect(Move move) noexcept;
+
+    /**
+     * Get the number of slots, which is the tour length.
+     */
+    std::size_t size() const noexcept;
+
+    /**
+     * Get the slot of the tour edge leading to the given position.
+     */
+    std::size_t slot(std::size_t cut) const noexcept;
+
+    /**
+     * Get the position to which the edge in the given slot leads.
+     */
+    std::size_t cut(std::size_t slot) const noexcept;
+
+    /**
+     * Determine whether the tour traverses the edge at the position from its first to its second end.
+     */
+    bool forward(std::size_t cut) const noexcept;
+
+    /**
+     * Get the two slots in which the last move exchanged the edges.
+     */
+    std::array<std::size_t, 2> changed() const noexcept;
+
+    /**
+     * Compute the value changes of exchanging the edge in the given slot with the edges in all slots.
+     *
+     * @param slot: slot of the first edge
+     * @param row: receives the value changes, by slot of the second edge
+     */
+    void deltas(std::size_t slot, ExchangeDeltas* row);
+
+private:
+
+    const Problem* problem_ = nullptr; //!< problem of the tracked solution
+    std::vector<Vertex> tour_; //!< tour of the tracked solution
+    std::vector<std::size_t> slots_; //!< slot of the edge leading to each position
+    std::vector<std::size_t> cuts_; //!< position to which the edge in each slot leads
+    std::vector<unsigned char> forward_; //!< orientation of the edge leading to each position
+    std::vector<std::pair<Vertex, Vertex>> ends_; //!< first and second end of the edge in each slot
+    std::vector<Value> edgeValues_; //!< value of the edge in each slot
+    std::vector<Value> firstRow_; //!< scratch: value from the first end of a slot to each vertex
+    std::vector<Value> secondRow_; //!< scratch: value from the second end of a slot to each vertex
+    Move expected_; //!< move announced for the tracked solution
+    std::array<std::size_t, 2> changed_ = {}; //!< slots exchanged by the last move
+
+    /**
+     * Assign the slots of all edges for the given solution.
+     */
+    void rebuild(const Solution& base);
+
+    /**
+     * Update the orientation of the edges leading to the positions [begin, end).
+     */
+    void orient(std::size_t begin, std::size_t end) noexcept;
+
+};
+
+/**
+ * Cache of the value changes of two-edge exchanges, keyed by the exchanged edges.
+ *
+ * For each pair of edge slots, the cache holds the value changes of both ways
+ * to reconnect them. After a move, only the two slots of the exchanged edges are
+ * computed again, in O(n).
+ *
+ * The cache takes 16 n^2 bytes of memory and its rows are read in slot order,
+ * not in tour order. Once the table no longer fits into the processor cache,
+ * the row scan over the edge values is faster, so steps only use the cache
+ * up to `maxVertices`.
+ */
+export class DeltaCache
+{
+
+public:
+
+    static constexpr std::size_t maxVertices = 128; //!< largest tour for which steps use the cache (256 KiB)
+
+    /**
+     * Bring the cache up to date for the given solution.
+     *
+     * If the solution is the result of the last expected move, the cache is
+     * updated incrementally. Otherwise, it is built from scratch.
+     */
+    void sync(const Solution& base);
+
+    /**
+     * Announce that the given move is about to be applied to the synchronized solution.
+     */
+    void expect(Move move) noexcept;
+
+    /**
+     * Get the value change of exchanging the tour edges at the given positions.
+     *
+     * @param cut1: the first edge to exchange is the edge leading to this position
+     * @param cut2: the second edge to exchange is the edge leading to this position
+     */
+    Value delta(std::size_t cut1, std::size_t cut2) const noexcept;
+
+    /**
+     * Get the slots of the tour edges.
+     */
+    const EdgeSlots& edges() const noexcept;
+
+    /**
+     * Get the entries for pairs of the given slot with all slots.
+     */
+    const ExchangeDeltas* row(std::size_t slot) const noexcept;
+
+private:
+
+    EdgeSlots edges_; //!< slots of the cached solution
+    std::vector<ExchangeDeltas> entries_; //!< pair entries, by slot, by slot
+
+};
+
+/**
+ * Ordered index of the value changes of two-edge exchanges.
+ *
+ * Since the objective is the absolute tour value, the best neighbor is the one
+ * whose value change is nearest to the negated tour value. The index holds the
+ * value changes for both ways to reconnect every pair of edge slots, sorted by
+ * value change, so that the best neighbor is found by walking outward from the
+ * target value instead of evaluating every neighbor.
+ *
+ * After a move, the keys of the two exchanged slots become stale. The new keys
+ * of these slots are sorted into a new run, and runs of similar size are merged,
+ * like in a log-structured merge tree. Stale keys are skipped by the queries and
+ * dropped once they make up half of the index.
+ *
+ * The index takes 16 to 32 n^2 bytes of memory, and every step function keeps its own,
+ * so steps only use it up to `maxVertices`.
+ */
+export class DeltaIndex
+{
+
+public:
+
+    static constexpr std::size_t maxVertices = 2048; //!< largest tour for which steps use the index (128 MiB)
+
+    //! The value change of one way to reconnect a pair of edge slots.
+    struct Key
+    {
+        Value delta; //!< value change of the exchange
+        std::uint16_t first; //!< slot of the first edge
+        std::uint16_t second; //!< slot of the second edge
+        std::uint32_t stamp; //!< version of the key, times two, plus one for the cross reconnection
+    };
+
+    /**
+     * Bring the index up to date for the given solution.
+     *
+     * If the solution is the result of the last expected move, the index is
+     * updated incrementally. Otherwise, it is built from scratch.
+     */
+    void sync(const Solution& base);
+
+    /**
+     * Announce that the given move is about to be applied to the synchronized solution.
+     */
+    void expect(Move move) noexcept;
+
+    /**
+     * Get the slots of the tour edges.
+     */
+    const EdgeSlots& edges() const noexcept;
+
+    /**
+     * Get the number of sorted runs in the index.
+     */
+    std::size_t runs() const noexcept;
+
+    /**
+     * Get the keys of the given run, sorted by value change.
+     */
+    std::pair<const Key*, const Key*> run(std::size_t index) const noexcept;
+
+    /**
+     * Determine whether the key holds the current value change of its slots.
+     */
+    bool current(const Key& key) const noexcept;
+
+private:
+
+    EdgeSlots edges_; //!< slots of the indexed solution
+    std::vector<Key> keys_; //!< all runs, one after another
+    std::vector<std::size_t> runEnds_; //!< end of each run in the keys
+    std::vector<std::uint32_t> versions_; //!< version in which each slot last changed
+    std::uint32_t version_ = 0; //!< version of the newest keys
+    std::vector<ExchangeDeltas> row_; //!< scratch: value changes of one slot
+
+    /**
+     * Build the index for all pairs of slots.
+     */
+    void rebuild();
+
+    /**
+     * Append the keys for pairs of the given slot with the other slots from `begin`.
+     */
+    void addKeys(std::size_t slot, std::size_t begin);
+
+    /**
+     * Merge the trailing runs while the last run is at least as large as the one before.
+     */
+    void mergeRuns();
+
+    /**
+     * Drop all stale keys and merge the remaining runs into one.
+     */
+    void compact();
+
+};
+
+/**
+ * Choice of where best improvement keeps the value changes of two-edge exchanges across steps.
+ */
+export enum class DeltaStore
+{
+    NONE, //!< compute all value changes in every step
+    CACHE, //!< look them up in a DeltaCache
+    INDEX //!< query the best one from a DeltaIndex
+};
+
 /**
  * Generate neighbors from the base solution by exchanging two edges.
  *
@@ -112,6 +468,13 @@ protected:
  * For example, if both the minimum and the maximum length are set to 2, this
  * will only allow switching the places of two adjacent vertexes in the tour sequence.
  * This neighborhood is very local.
+ *
+ * The functions for iteration and evaluation are final, so that step functions
+ * which know the neighborhood type can call them without virtual dispatch.
+ *
+ * Full scans evaluate one row of neighbors with a common first cut at a time.
+ * The edge values are laid out in tour order, so that the row is a vectorized
+ * sum over contiguous arrays (see `minAbsSum`).
  */
 export class TwoExchangeNeighborhood : public Neighborhood
 {
@@ -140,12 +503,80 @@ public:
     TwoExchangeNeighborhood(const TwoExchangeNeighborhood& rhs);
 
     void reset(std::size_t vertices) noexcept override;
-    std::size_t size() const noexcept override;
+    std::size_t size() const noexcept final;
     std::unique_ptr<Neighborhood> clone() const override;
-    TwoExchangeNeighborhood& operator++() override;
-    Value objective(const Solution& base) const noexcept override;
-    void apply(Solution& solution) const override;
-    bool operator!=(std::default_sentinel_t) const noexcept override;
+    TwoExchangeNeighborhood& operator++() final;
+    void seek(std::size_t index) final;
+    Value objective(const Solution& base) const noexcept final;
+    Move current() const noexcept final;
+    Move bestMove(const Solution& base, Value bound) final;
+    Move firstMove(const Solution& base, Value bound) final;
+    bool operator!=(std::default_sentinel_t) const noexcept final;
+
+    /**
+     * Scan the neighborhood for the neighbor with the best objective, like `bestMove`,
+     * but read the value changes from the cache instead of the edge values.
+     *
+     * @param base: base solution
+     * @param bound: only neighbors with an objective below this value are accepted
+     * @param cache: delta cache, which is synchronized with the base solution
+     * @return: the best neighbor, or a NONE move if no neighbor is below the bound
+     */
+    Move bestMove(const Solution& base, Value bound, DeltaCache& cache);
+
+    /**
+     * Find the neighbor with the best objective, like `bestMove`, by walking
+     * outward from the target value in the index instead of scanning.
+     *
+     * @param base: base solution
+     * @param bound: only neighbors with an objective below this value are accepted
+     * @param index: delta index, which is synchronized with the base solution
+     * @return: the best neighbor, or a NONE move if no neighbor is below the bound
+     */
+    Move bestMove(const Solution& base, Value bound, DeltaIndex& index);
+
+    /**
+     * Scan the neighborhood for the neighbor with the best objective, like `bestMove`,
+     * but split the rows among the threads of the pool.
+     *
+     * The rows are cut into chunks with about the same number of neighbors, which the
+     * threads take in turn. The best move of every chunk is merged in scan order, so the
+     * result is the same as that of the serial scan. Tours with fewer than
+     * `parallelMinVertices` vertices are scanned serially.
+     *
+     * @param base: base solution
+     * @param bound: only neighbors with an objective below this value are accepted
+     * @param pool: threads which scan the chunks
+     * @return: the best neighbor, or a NONE move if no neighbor is below the bound
+     */
+    Move bestMove(const Solution& base, Value bound, ThreadPool& pool);
+
+    /**
+     * Below this number of vertices, a scan is too short to be worth splitting among threads.
+     *
+     * From the step benchmark: handing a scan to a pool costs about 5 us with 2 threads and
+     * 15 us with 8 threads, while a serial scan of 500 vertices takes about 150 us.
+     */
+    static constexpr std::size_t parallelMinVertices = 500;
+
+    /**
+     * Mark all vertices of the base solution as active for don't-look scans.
+     */
+    void activateAll(const Solution& base);
+
+    /**
+     * Scan only the moves at active vertices for an improving move, in queue order.
+     *
+     * The moves at a vertex are those which exchange one of its two tour edges.
+     * A vertex without an improving move becomes inactive. When a move is found,
+     * the endpoints of its two exchanged edges are activated, so the caller must apply it.
+     * When the queue runs empty after any move was found, all vertices are activated again.
+     *
+     * @param base: base solution
+     * @param bound: only neighbors with an objective below this value are accepted
+     * @return: the best move at the first active vertex which has one, or a NONE move
+     */
+    Move activeMove(const Solution& base, Value bound);
 
 protected:
 
@@ -154,6 +585,80 @@ protected:
     std::size_t cut1_; //!< first edge to exchange is before vertex at this position
     std::size_t cut2_; //!< second edge to exchange is before vertex at this position
 
+private:
+
+    std::size_t resetCut2_; //!< second cut of the first neighbor after reset
+
+    // buffers for row-wise scans, indexed by tour position
+    std::vector<std::size_t> positions_; //!< tour position of every vertex
+    std::vector<Value> edges_; //!< value of the tour edge leading to each position
+    std::vector<Value> prevRow_; //!< value of the edge from the vertex before the first cut to each position
+    std::vector<Value> nextRow_; //!< value of the edge from the vertex after the first cut to each position
+    std::vector<std::vector<Value>> threadRows_; //!< parallel scans: prev and next row of each thread after the first
+    Value threadRowsBigM_ = 0; //!< big-M value of the problem which the thread rows were filled for
+    bool threadRowsClean_ = false; //!< whether the last parallel scan completed, leaving the thread rows at big-M
+
+    // don't-look state
+    std::vector<Vertex> queue_; //!< ring buffer of active vertices
+    std::vector<unsigned char> active_; //!< whether each vertex is in the queue
+    std::size_t queueHead_ = 0; //!< queue position of the next active vertex
+    std::size_t queueSize_ = 0; //!< number of active vertices
+    bool sweepImproved_ = false; //!< whether a move was found since all vertices were last activated
+
+    //! A range [begin, end) of second cut positions.
+    struct CutRange
+    {
+        std::size_t begin;
+        std::size_t end;
+    };
+
+    /**
+     * Fill the scan buffers for the given base solution.
+     */
+    void prepareScan(const Solution& base);
+
+    /**
+     * Get the ranges of valid distances between two cuts, in ascending order.
+     * The second range is empty (begin == end) unless the valid distances are split in two.
+     */
+    std::array<CutRange, 2> distanceRanges() const noexcept;
+
+    /**
+     * Get the ranges of valid second cuts for the given first cut, in iteration order.
+     * The second range is empty (begin == end) unless the valid cuts are split in two.
+     */
+    std::array<CutRange, 2> rowRanges(std::size_t cut1) const noexcept;
+
+    /**
+     * Count the valid neighbors whose first cut lies before the given position, in O(1).
+     */
+    std::size_t countBefore(std::size_t cut1) const noexcept;
+
+    /**
+     * Find the best move which exchanges the tour edge leading to the given position.
+     * The scan buffers must be prepared for the base solution.
+     *
+     * @return: the move and its objective, or a NONE move and the bound
+     */
+    std::pair<Move, Value> bestMoveAt(const Solution& base, std::size_t cut, Value bound);
+
+    /**
+     * Find the first best move in the rows [rowBegin, rowEnd) of a full scan.
+     * The scan buffers must be prepared for the base solution.
+     *
+     * @param firstCut2: second cut of the neighbor at reset, which row 0 skips
+     * @param prevRow: scratch row of big-M values for the vertex before the first cut
+     * @param nextRow: scratch row of big-M values for the vertex after the first cut
+     * @return: the move and its objective, or a NONE move and the bound
+     */
+    std::pair<Move, Value> bestMoveInRows(const Solution& base, std::size_t rowBegin, std::size_t rowEnd,
+        std::size_t firstCut2, Value bound, std::vector<Value>& prevRow, std::vector<Value>& nextRow) const;
+
+    /**
+     * Add the vertex to the queue of active vertices, unless it is already active.
+     */
+    void activate(Vertex vertex) noexcept;
+
 };
 
 /**
@@ -209,6 +714,12 @@ public:
 
     virtual ~Step() noexcept = default;
 
+    /**
+     * Forget any knowledge about previous steps.
+     * Local search calls this before it starts to descend from a new solution.
+     */
+    virtual void restart() noexcept;
+
     /**
      * Modify the solution by one step according to the step rules.
      *
@@ -224,9 +735,14 @@ protected:
 };
 
 /**
- * First improvement step function.
+ * First improvement step function for neighborhoods of type N.
+ *
+ * The scan over the neighbors is compiled against N, so that it inlines
+ * into one loop if N is a concrete neighborhood with final members.
+ * FirstImprovement is the variant for any Neighborhood, using virtual calls.
  */
-export class FirstImprovement : public Step
+export template<std::derived_from<Neighborhood> N>
+class BasicFirstImprovement : public Step
 {
 
 public:
@@ -234,36 +750,139 @@ public:
     /**
      * Construct the first improvement step function for the given neighborhood.
      */
-    explicit FirstImprovement(std::unique_ptr<Neighborhood> neighborhood) noexcept;
+    explicit BasicFirstImprovement(std::unique_ptr<N> neighborhood) noexcept
+        : Step(std::move(neighborhood))
+    {
+    }
 
     /**
      * Modify the solution to the first neighbor which offers an improvement over the base value.
      */
-    virtual void step(Solution& base) override;
+    virtual void step(Solution& base) override
+    {
+        N& neighborhood = static_cast<N&>(*neighborhood_);
+        neighborhood.firstMove(base, base.objective()).apply(base);
+    }
 
 };
 
+export using FirstImprovement = BasicFirstImprovement<Neighborhood>;
 
 /**
- * Best improvement step function.
+ * Best improvement step function for neighborhoods of type N.
+ *
+ * The scan over the neighbors is compiled against N, so that it inlines
+ * into one loop if N is a concrete neighborhood with final members.
+ * BestImprovement is the variant for any Neighborhood, using virtual calls.
+ *
+ * For two-exchange neighborhoods, the step can keep a DeltaCache or a DeltaIndex across steps.
+ * Otherwise, it can split the scan of large tours among multiple threads.
  */
-export class BestImprovement : public Step
+export template<std::derived_from<Neighborhood> N>
+class BasicBestImprovement : public Step
 {
 
 public:
 
     /**
      * Construct the best improvement step function for the given neighborhood.
+     *
+     * @param neighborhood: neighborhood to scan
+     * @param deltaStore: where to keep the value changes across steps, if N is a
+     *                   two-exchange neighborhood and the tour is small enough
+     * @param threads: number of threads for scans without delta store, if N is a
+     *                 two-exchange neighborhood and the tour is large enough
      */
-    explicit BestImprovement(std::unique_ptr<Neighborhood> neighborhood) noexcept;
+    explicit BasicBestImprovement(std::unique_ptr<N> neighborhood, DeltaStore deltaStore = DeltaStore::NONE,
+        int threads = 1) noexcept
+        : Step(std::move(neighborhood)), deltaStore_(deltaStore), threads_(threads)
+    {
+    }
 
     /**
      * Modify the solution to the neighbor which offers the best improvement over the base value.
      */
-    virtual void step(Solution& base) override;
+    virtual void step(Solution& base) override
+    {
+        N& neighborhood = static_cast<N&>(*neighborhood_);
+
+        if constexpr (std::derived_from<N, TwoExchangeNeighborhood>) {
+            if (DeltaStore::CACHE == deltaStore_ && base.length() <= DeltaCache::maxVertices) {
+                const Move move = neighborhood.bestMove(base, base.objective(), cache_);
+                cache_.expect(move);
+                move.apply(base);
+                return;
+            }
+
+            if (DeltaStore::INDEX == deltaStore_ && base.length() <= DeltaIndex::maxVertices) {
+                const Move move = neighborhood.bestMove(base, base.objective(), index_);
+                index_.expect(move);
+                move.apply(base);
+                return;
+            }
+
+            if (threads_ > 1 && base.length() >= TwoExchangeNeighborhood::parallelMinVertices) {
+                // the workers wait in the pool between steps, for the whole descent
+                if (!pool_)
+                    pool_ = std::make_unique<ThreadPool>(threads_);
+
+                neighborhood.bestMove(base, base.objective(), *pool_).apply(base);
+                return;
+            }
+        }
+
+        neighborhood.bestMove(base, base.objective()).apply(base);
+    }
+
+private:
+
+    DeltaStore deltaStore_; //!< where to keep the value changes
+    int threads_; //!< number of threads for scans
+    std::unique_ptr<ThreadPool> pool_; //!< threads for scans, started at the first large tour
+    DeltaCache cache_; //!< value changes of the neighbors, kept across steps
+    DeltaIndex index_; //!< ordered value changes of the neighbors, kept across steps
 
 };
 
+export using BestImprovement = BasicBestImprovement<Neighborhood>;
+
+
+/**
+ * Best improvement step function with don't-look bits.
+ *
+ * Only moves which exchange a tour edge at an active vertex are scanned.
+ * A vertex becomes inactive when none of its moves improve the solution and
+ * active again when one of its tour edges changes. A step applies the best move
+ * at the first active vertex which has an improving move, which costs O(n) per
+ * vertex instead of a full O(n^2) scan.
+ *
+ * Since the objective is the absolute tour value, a move can become improving
+ * after other moves changed the total. Therefore, once no vertex is active,
+ * all vertices are activated again, and the descent ends at a local optimum
+ * only when a sweep over all vertices finds no improving move.
+ */
+export class DontLookImprovement : public Step
+{
+
+public:
+
+    /**
+     * Construct the don't-look step function for the given neighborhood.
+     */
+    explicit DontLookImprovement(std::unique_ptr<TwoExchangeNeighborhood> neighborhood) noexcept;
+
+    virtual void restart() noexcept override;
+
+    /**
+     * Modify the solution by the best improving move at the next active vertex.
+     */
+    virtual void step(Solution& base) override;
+
+private:
+
+    bool restarted_; //!< whether all vertices must be activated before the next step
+
+};
 
 /**
  * Random step function.
@@ -308,8 +927,9 @@ public:
      * Construct the local search.
      *
      * @param step: step function
+     * @param layout: tour data structure to use during the search
      */
-    explicit LocalSearch(std::unique_ptr<Step> step) noexcept;
+    explicit LocalSearch(std::unique_ptr<Step> step, TourLayout layout = TourLayout::ARRAY) noexcept;
 
     /**
      * Execute the search from the given start solution.
@@ -322,6 +942,7 @@ public:
 private:
 
     std::unique_ptr<Step> step_;
+    TourLayout layout_;
 
 };
 
@@ -339,10 +960,12 @@ public:
      *
      * @param construction: factory for the initial solution
      * @param step: step function
+     * @param layout: tour data structure to use during the search
      */
     explicit StandaloneLocalSearch(
         std::unique_ptr<Construction> construction,
-        std::unique_ptr<Step> step) noexcept;
+        std::unique_ptr<Step> step,
+        TourLayout layout = TourLayout::ARRAY) noexcept;
 
     /**
      * Execute the search for the given instance.
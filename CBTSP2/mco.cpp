@@ -5,11 +5,23 @@ module;
 #include <ranges>
 #include <random>
 #include <vector>
+#include <algorithm>
+#include <limits>
+#include <cmath>
 #include <cassert>
+#include <utility>
+#include <cstdint>
+
+// SSE is part of every x64 target, so the pheromone pass needs no run time dispatch.
+#if defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#define CBTSP_SSE2
+#endif
 
 module mco;
 
 import cbtsp;
+import util;
 
 /**
  * Normalize the given objective value according to the minimum and maximum value in the problem.
@@ -19,18 +31,137 @@ Pheromone normObj(Value objective, const Problem& problem)
     return static_cast<Pheromone>(objective) / (problem.max() - problem.min());
 }
 
-McoState::McoState(const Problem& problem, Pheromone init, Pheromone min, Pheromone max)
-    : problem_(&problem), min_(min), max_(max),
-    pheromone_(problem.vertices(), init), delta_(problem.vertices(), 0.f)
+/**
+ * Raise the incentive to the power of its attraction.
+ * The common linear attraction does not need to call pow.
+ */
+Pheromone attract(Pheromone incentive, float attraction) noexcept
+{
+    return 1.f == attraction ? incentive : std::pow(incentive, attraction);
+}
+
+/**
+ * Clamp the pheromone levels to [min, max], then revert them toward the lowest level.
+ *
+ * @param levels: pheromone levels to update in place
+ * @param count: number of levels
+ * @param keep: factor of the clamped level which remains
+ * @param floor: share of the lowest level which is added
+ */
+void revertPheromones(Pheromone* levels, std::size_t count,
+    Pheromone min, Pheromone max, Pheromone keep, Pheromone floor) noexcept
+{
+    std::size_t i = 0;
+
+#ifdef CBTSP_SSE2
+    const __m128 minLanes = _mm_set1_ps(min);
+    const __m128 maxLanes = _mm_set1_ps(max);
+    const __m128 keepLanes = _mm_set1_ps(keep);
+    const __m128 floorLanes = _mm_set1_ps(floor);
+
+    for (; i + 4 <= count; i += 4) {
+        const __m128 clamped = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(levels + i), minLanes), maxLanes);
+        _mm_storeu_ps(levels + i, _mm_add_ps(_mm_mul_ps(keepLanes, clamped), floorLanes));
+    }
+#endif
+
+    for (; i < count; i++)
+        levels[i] = keep * std::min(std::max(levels[i], min), max) + floor;
+}
+
+McoState::McoState(const Problem& problem, Pheromone init, Pheromone min, Pheromone max,
+    float pheromoneAttraction, std::size_t candidates)
+    : problem_(&problem), min_(min), max_(max), pheromoneAttraction_(pheromoneAttraction),
+    background_(init), backgroundAttraction_(attract(init, pheromoneAttraction)),
+    links_(problem.vertices())
 {
+    // every real edge gets an explicit level, listed in the order of the neighbors
+    for (Vertex v = 0; v < problem.vertices(); v++) {
+        for (const Vertex w : problem.neighbors(v)) {
+            if (w > v)
+                add(v, w);
+        }
+    }
+
+    realEdges_ = pheromone_.size();
+
+    if (0 == candidates)
+        return;
+
+    // pick the real edges with the lowest absolute values
+    std::vector<std::size_t> order;
+    candidateOffsets_.push_back(0);
+
+    for (Vertex v = 0; v < problem.vertices(); v++) {
+        const auto neighbors = problem.neighbors(v);
+        const auto values = problem.neighborValues(v);
+        const std::size_t count = std::min(candidates, neighbors.size());
+
+        order.resize(neighbors.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::partial_sort(order.begin(), order.begin() + count, order.end(),
+            [values](std::size_t i, std::size_t j)
+            {
+                return std::abs(values[i]) < std::abs(values[j]) ||
+                    (std::abs(values[i]) == std::abs(values[j]) && i < j);
+            });
+
+        for (std::size_t i = 0; i < count; i++)
+            candidates_.push_back(neighbors[order[i]]);
+
+        candidateOffsets_.push_back(candidates_.size());
+    }
 }
 
 Pheromone McoState::pheromone(Vertex a, Vertex b) const noexcept
 {
-    return pheromone_.at(a, b);
+    const std::uint32_t edge = find(a, b);
+    return none == edge ? background_ : pheromone_[edge];
+}
+
+Pheromone McoState::attraction(Vertex a, Vertex b) const noexcept
+{
+    const std::uint32_t edge = find(a, b);
+    if (none == edge)
+        return backgroundAttraction_;
+
+    // with linear attraction, the attractions are not kept
+    return 1.f == pheromoneAttraction_ ? pheromone_[edge] : attraction_[edge];
+}
+
+Pheromone McoState::backgroundAttraction() const noexcept
+{
+    return backgroundAttraction_;
+}
+
+void McoState::scatter(std::vector<Pheromone>& row, Vertex vertex, bool set) const noexcept
+{
+    const bool linear = 1.f == pheromoneAttraction_;
+    for (const auto& link : links_[vertex]) {
+        if (!set)
+            row[link.neighbor] = backgroundAttraction_;
+        else
+            row[link.neighbor] = linear ? pheromone_[link.edge] : attraction_[link.edge];
+    }
+}
+
+std::size_t McoState::explicitEdges() const noexcept
+{
+    return pheromone_.size();
+}
+
+bool McoState::restricted() const noexcept
+{
+    return !candidateOffsets_.empty();
+}
+
+std::span<const Vertex> McoState::candidates(Vertex vertex) const noexcept
+{
+    assert(restricted());
+    return { candidates_.data() + candidateOffsets_[vertex], candidates_.data() + candidateOffsets_[vertex + 1] };
 }
 
-void McoState::reinforce(const Solution& solution, float scale) noexcept
+void McoState::reinforce(const Solution& solution, float scale)
 {
     assert(!solution.isPartial());
 
@@ -38,36 +169,124 @@ void McoState::reinforce(const Solution& solution, float scale) noexcept
     const auto& vs = solution.vertices();
     Vertex prev = vs.back();
     for (auto v : vs) {
-        delta_.at(prev, v) += delta;
+        std::uint32_t edge = find(prev, v);
+        if (none == edge)
+            edge = add(prev, v);
+
+        if (0.f == delta_[edge])
+            touched_.push_back(edge);
+
+        delta_[edge] += delta;
         prev = v;
     }
 }
 
-void McoState::evaporate(float evaporation) noexcept
+void McoState::update(float evaporation) noexcept
 {
-    for (Pheromone& p : pheromone_.all())
-    {
-        p = (1.f - evaporation) * p + evaporation * min_;
+    // only the reinforced edges have pending changes
+    if (!touched_.empty())
+        reinforcement_ = 0.f;
+
+    for (const std::uint32_t edge : touched_) {
+        reinforcement_ = std::max(reinforcement_, std::abs(delta_[edge]));
+        pheromone_[edge] += std::exchange(delta_[edge], 0.f);
+    }
+
+    touched_.clear();
+
+    // one streaming pass over the explicit edges clamps, evaporates and refreshes the attractions
+    const Pheromone keep = 1.f - evaporation;
+    const Pheromone floor = evaporation * min_;
+    revertPheromones(&background_, 1, min_, max_, keep, floor);
+    backgroundAttraction_ = attract(background_, pheromoneAttraction_);
+
+    if (1.f == pheromoneAttraction_) {
+        revertPheromones(pheromone_.data(), pheromone_.size(), min_, max_, keep, floor);
+    }
+    else {
+        for (std::size_t i = 0; i < pheromone_.size(); i++) {
+            revertPheromones(&pheromone_[i], 1, min_, max_, keep, floor);
+            attraction_[i] = std::pow(pheromone_[i], pheromoneAttraction_);
+        }
+    }
+
+    // reinforced edges near the background level hardly make a difference to the mice anymore
+    const Pheromone tolerance = dropTolerance * (std::abs(background_) + reinforcement_);
+    for (std::size_t edge = pheromone_.size(); edge-- > realEdges_;) {
+        if (std::abs(pheromone_[edge] - background_) <= tolerance)
+            drop(static_cast<std::uint32_t>(edge));
     }
 }
 
-void McoState::update() noexcept
+std::uint32_t McoState::find(Vertex a, Vertex b) const noexcept
+{
+    const auto& links = links_[a];
+    const auto real = links.begin() + problem_->neighbors(a).size();
+    const auto byNeighbor = [](const Link& link, Vertex neighbor) { return link.neighbor < neighbor; };
+
+    auto it = std::lower_bound(links.begin(), real, b, byNeighbor);
+    if (real != it && b == it->neighbor)
+        return it->edge;
+
+    it = std::lower_bound(real, links.end(), b, byNeighbor);
+    return links.end() != it && b == it->neighbor ? it->edge : none;
+}
+
+std::vector<McoState::Link>::iterator McoState::reinforcedLink(Vertex a, Vertex b) noexcept
+{
+    // while the real edges are added, all links go to the end in order
+    auto& links = links_[a];
+    const auto real = links.begin() + std::min(links.size(), problem_->neighbors(a).size());
+    return std::lower_bound(real, links.end(), b, [](const Link& link, Vertex neighbor) { return link.neighbor < neighbor; });
+}
+
+std::uint32_t McoState::add(Vertex a, Vertex b)
 {
-    auto& pheromone = pheromone_.all();
-    auto& delta = delta_.all();
+    const auto edge = static_cast<std::uint32_t>(pheromone_.size());
+    links_[a].insert(reinforcedLink(a, b), { b, edge });
+    links_[b].insert(reinforcedLink(b, a), { a, edge });
+    ends_.push_back({ a, b });
+    pheromone_.push_back(background_);
+    if (1.f != pheromoneAttraction_)
+        attraction_.push_back(backgroundAttraction_);
+    delta_.push_back(0.f);
+    return edge;
+}
+
+void McoState::drop(std::uint32_t edge) noexcept
+{
+    assert(edge >= realEdges_);
+    assert(0.f == delta_[edge]);
+
+    // forget the links to the edge
+    const auto [a, b] = ends_[edge];
+    links_[a].erase(reinforcedLink(a, b));
+    links_[b].erase(reinforcedLink(b, a));
 
-    for (std::size_t i = 0; i < pheromone.size(); i++) {
-        pheromone[i] = std::clamp(pheromone[i] + delta[i], min_, max_);
+    // move the last edge into the free id
+    const auto last = static_cast<std::uint32_t>(pheromone_.size() - 1);
+    if (edge != last) {
+        const auto [c, d] = ends_[last];
+        reinforcedLink(c, d)->edge = edge;
+        reinforcedLink(d, c)->edge = edge;
+
+        ends_[edge] = ends_[last];
+        pheromone_[edge] = pheromone_[last];
+        if (1.f != pheromoneAttraction_)
+            attraction_[edge] = attraction_[last];
+        delta_[edge] = delta_[last];
     }
 
-    std::ranges::fill(delta, 0.f);
+    ends_.pop_back();
+    pheromone_.pop_back();
+    if (1.f != pheromoneAttraction_)
+        attraction_.pop_back();
+    delta_.pop_back();
 }
 
-Mouse::Mouse(const Problem& problem, McoState& state,
-    float pheromoneAttraction, float objectiveAttraction,
+Mouse::Mouse(const Problem& problem, McoState& state, float objectiveAttraction,
     float intensification, const std::shared_ptr<Random>& random) noexcept
-    : problem_(&problem), state_(&state),
-    pheromoneAttraction_(pheromoneAttraction), objectiveAttraction_(objectiveAttraction),
+    : problem_(&problem), state_(&state), objectiveAttraction_(objectiveAttraction),
     intensification_(intensification), random_(random)
 {
     assert(random);
@@ -76,66 +295,246 @@ Mouse::Mouse(const Problem& problem, McoState& state,
 Solution Mouse::construct()
 {
     const std::size_t n = problem_->vertices();
-    std::vector<Vertex> tour(n, 0);
-    std::iota(tour.begin(), tour.end(), 0);
-    std::ranges::shuffle(tour, *random_);
-
-    Solution solution(*problem_, move(tour));
+    const bool restricted = state_->restricted();
+    tour_.resize(n);
+    std::iota(tour_.begin(), tour_.end(), 0);
+    std::ranges::shuffle(tour_, *random_);
 
     // starting location is random
-    std::size_t start = std::uniform_int_distribution{ 0ull, n - 1 }(*random_);
-    if (start > 0)
-        solution.twoOpt(0, (start + 1) % n);
+    const std::size_t start = std::uniform_int_distribution<std::size_t>{ 0, n - 1 }(*random_);
+    if (restricted)
+        std::swap(tour_[0], tour_[start]);
+
+    edges_.resize(n);
+    value_ = 0;
+    for (std::size_t i = 0; i < n; i++) {
+        refreshEdge(i);
+        value_ += edges_[i];
+    }
+    if (n < 2)
+        value_ = 0; // like Solution, a single vertex has no edge
+
+    const Value bigM = problem_->bigM();
+    firstRow_.assign(n, bigM);
+    lastRow_.assign(n, bigM);
+    first_ = tour_.front();
+    last_ = tour_.back();
+    scatter(firstRow_, first_, true);
+    scatter(lastRow_, last_, true);
+    attractionRow_.assign(n, state_->backgroundAttraction());
+
+    if (restricted) {
+        positions_.resize(n);
+        for (std::size_t i = 0; i < n; i++)
+            positions_[tour_[i]] = i;
 
-    for (std::size_t i = 1; i < n; i++) {
-        // find next vertex based on neighbors and pheromones
-        const auto next = decideNext(solution, i);
-        solution.twoOpt(i, (next + 1) % n);
+        for (std::size_t i = 1; i < n; i++) {
+            // find next vertex based on candidates and pheromones
+            swap(i, decideCandidate(i));
+        }
+    }
+    else {
+        if (start > 0)
+            exchange(0, (start + 1) % n);
+
+        for (std::size_t i = 1; i < n; i++) {
+            // find next vertex based on neighbors and pheromones
+            const auto next = decideNext(i);
+            exchange(i, (next + 1) % n);
+        }
     }
 
     // Note: reinforcement to be handled by the caller
-    return solution;
+    return Solution(*problem_, std::vector<Vertex>(tour_), value_);
 }
 
-std::size_t Mouse::decideNext(const Solution& solution, std::size_t position)
+std::size_t Mouse::decideNext(std::size_t position)
 {
     assert(position > 0); // first vertex must be decided at random
 
-    const std::size_t n = problem_->vertices();
-    std::vector<Pheromone> incentive(n - position, 0);
+    const std::size_t n = tour_.size();
+    const auto from = tour_[position - 1];
+
+    cumulative_.clear();
+    state_->scatter(attractionRow_, from, true);
+    for (std::size_t i = position; i < n; i++)
+        addIncentive(tour_[i], exchangeValue(i));
+
+    state_->scatter(attractionRow_, from, false);
+    return choose() + position;
+}
+
+std::size_t Mouse::decideCandidate(std::size_t position)
+{
+    assert(position > 0); // first vertex must be decided at random
 
-    const auto from = solution.vertices()[position - 1];
+    const Vertex from = tour_[position - 1];
+    cumulative_.clear();
+    slots_.clear();
+    state_->scatter(attractionRow_, from, true);
+
+    for (const Vertex to : state_->candidates(from)) {
+        const std::size_t slot = positions_[to];
+        if (slot >= position) {
+            addIncentive(to, exchangeValue(slot));
+            slots_.push_back(slot);
+        }
+    }
+
+    // all candidates visited: fall back to all unvisited vertices
+    if (slots_.empty()) {
+        for (std::size_t slot = position; slot < tour_.size(); slot++) {
+            addIncentive(tour_[slot], exchangeValue(slot));
+            slots_.push_back(slot);
+        }
+    }
+
+    state_->scatter(attractionRow_, from, false);
+    return slots_[choose()];
+}
+
+void Mouse::addIncentive(Vertex to, Value value)
+{
+    const auto objective = 1.f / normObj(std::abs(value), *problem_);
+    const Pheromone incentive = attractionRow_[to] + attract(objective, objectiveAttraction_);
+    const double total = cumulative_.empty() ? 0. : cumulative_.back();
 
-    for (std::size_t i = position; i < n; i++) {
-        const auto to = solution.vertices()[i];
-        const auto pheromone = state_->pheromone(from, to);
-        const auto objective = 1.f / normObj(std::abs(solution.twoOptValue(0, i)), *problem_);
-        incentive[i - position] = std::pow(pheromone, pheromoneAttraction_)
-            + std::pow(objective, objectiveAttraction_);
+    // remember the first max incentivized
+    if (cumulative_.empty() || incentive > bestIncentive_) {
+        best_ = cumulative_.size();
+        bestIncentive_ = incentive;
     }
 
+    cumulative_.push_back(total + incentive);
+}
+
+std::size_t Mouse::choose()
+{
+    assert(!cumulative_.empty());
+    const double total = cumulative_.back();
+
     // diversification or intensification?
-    if (std::generate_canonical<float, std::numeric_limits<float>::digits>(*random_) < intensification_) {
+    if (std::generate_canonical<float, std::numeric_limits<float>::digits>(*random_) < intensification_
+        || !(total > 0.) || std::isinf(total)) {
         // choose max incentivized
-        return std::ranges::max_element(incentive) - incentive.begin() + position;
+        return best_;
     }
     else {
-        // choose according to incentives as probabilities
-        auto distribution = std::discrete_distribution<std::size_t>{ incentive.begin(), incentive.end() };
-        return distribution(*random_) + position;
+        // choose according to incentives as probabilities, by roulette wheel;
+        // a float sum would leave no room for small incentives next to large ones
+        const double ball = std::uniform_real_distribution<double>{ 0., total }(*random_);
+        const std::size_t slot = std::upper_bound(cumulative_.begin(), cumulative_.end(), ball) - cumulative_.begin();
+        return std::min(slot, cumulative_.size() - 1);
+    }
+}
+
+Value Mouse::exchangeValue(std::size_t position) const noexcept
+{
+    const std::size_t n = tour_.size();
+
+    // no change?
+    if (position < 2 || n - position < 2)
+        return value_;
+
+    // the first and last vertex are never at the position or just before it
+    return value_ + lastRow_[tour_[position - 1]] + firstRow_[tour_[position]]
+        - edges_[0] - edges_[position];
+}
+
+void Mouse::exchange(std::size_t v1, std::size_t v2) noexcept
+{
+    const std::size_t n = tour_.size();
+    const auto [low, high] = std::minmax(v1, v2);
+
+    if (high == low)
+        return;
+
+    // no change in value?
+    if (high - low >= 2 && low + n - high >= 2) {
+        const Vertex prev1 = tour_[(low + n - 1) % n];
+        const Vertex prev2 = tour_[high - 1];
+        value_ += problem_->value(prev1, prev2) + problem_->value(tour_[low], tour_[high])
+            - edges_[low] - edges_[high];
     }
+
+    // the edges within the reversed range are the same, in reverse order
+    std::reverse(tour_.begin() + low, tour_.begin() + high);
+    std::reverse(edges_.begin() + low + 1, edges_.begin() + high);
+    refreshEdge(low);
+    refreshEdge(high);
+    refreshRows();
+}
+
+void Mouse::swap(std::size_t a, std::size_t b) noexcept
+{
+    assert(a <= b);
+    const std::size_t n = tour_.size();
+
+    if (a == b)
+        return;
+
+    // the distinct tour edges at both positions
+    std::size_t changed[4] = { a, a + 1, b, (b + 1) % n };
+    const std::size_t count = b == a + 1 ? 3 : 4;
+    if (3 == count)
+        changed[2] = changed[3];
+
+    for (std::size_t i = 0; i < count; i++)
+        value_ -= edges_[changed[i]];
+
+    std::swap(tour_[a], tour_[b]);
+    positions_[tour_[a]] = a;
+    positions_[tour_[b]] = b;
+
+    for (std::size_t i = 0; i < count; i++) {
+        refreshEdge(changed[i]);
+        value_ += edges_[changed[i]];
+    }
+
+    refreshRows();
+}
+
+void Mouse::refreshEdge(std::size_t position) noexcept
+{
+    const std::size_t n = tour_.size();
+    position %= n;
+    edges_[position] = problem_->value(tour_[(position + n - 1) % n], tour_[position]);
+}
+
+void Mouse::refreshRows() noexcept
+{
+    if (tour_.front() != first_) {
+        scatter(firstRow_, first_, false);
+        first_ = tour_.front();
+        scatter(firstRow_, first_, true);
+    }
+
+    if (tour_.back() != last_) {
+        scatter(lastRow_, last_, false);
+        last_ = tour_.back();
+        scatter(lastRow_, last_, true);
+    }
+}
+
+void Mouse::scatter(std::vector<Value>& row, Vertex vertex, bool set) const noexcept
+{
+    const auto neighbors = problem_->neighbors(vertex);
+    const auto values = problem_->neighborValues(vertex);
+    for (std::size_t i = 0; i < neighbors.size(); i++)
+        row[neighbors[i]] = set ? values[i] : problem_->bigM();
 }
 
 Mco::Mco(int ticks, int mice, float evaporation, float elitism,
     float minPheromone, float maxPheromone,
     float pheromoneAttraction, float objectiveAttraction,
     float intensification, ReinforceStrategy reinforceStrategy,
-    const std::shared_ptr<Random>& random, std::unique_ptr<LocalSearch> improvement) noexcept
+    const std::shared_ptr<Random>& random, std::unique_ptr<LocalSearch> improvement,
+    std::size_t candidates) noexcept
     : ticks_(ticks), mice_(mice), evaporation_(evaporation), elitism_(elitism),
     minPheromone_(minPheromone), maxPheromone_(maxPheromone),
     pheromoneAttraction_(pheromoneAttraction), objectiveAttraction_(objectiveAttraction),
     intensification_(intensification), reinforceStrategy_(reinforceStrategy),
-    random_(move(random)), improvement_(move(improvement))
+    random_(move(random)), improvement_(move(improvement)), candidates_(candidates)
 {
     assert(ticks > 0);
     assert(mice > 0);
@@ -146,24 +545,73 @@ Mco::Mco(int ticks, int mice, float evaporation, float elitism,
     assert(intensification >= 0.f);
     assert(intensification <= 1.f);
     assert(random_);
-    assert(improvement_);
+}
+
+Mco::Mco(int ticks, int mice, float evaporation, float elitism,
+    float minPheromone, float maxPheromone,
+    float pheromoneAttraction, float objectiveAttraction,
+    float intensification, ReinforceStrategy reinforceStrategy,
+    const std::shared_ptr<Random>& random, const ImprovementFactory& buildImprovement,
+    int threads, std::size_t candidates)
+    : Mco(ticks, mice, evaporation, elitism, minPheromone, maxPheromone,
+        pheromoneAttraction, objectiveAttraction, intensification, reinforceStrategy,
+        random, nullptr, candidates)
+{
+    assert(threads > 0);
+
+    for (int i = 0; i < std::min(threads, mice); i++) {
+        randoms_.push_back(std::make_shared<Random>());
+        improvements_.push_back(buildImprovement(randoms_.back()));
+    }
+
+    pool_ = std::make_unique<ThreadPool>(static_cast<int>(improvements_.size()));
 }
 
 Solution Mco::search(const Problem& problem)
 {
-    auto state = McoState{ problem, maxPheromone_, minPheromone_, maxPheromone_ };
-    auto mouse = Mouse{ problem, state, pheromoneAttraction_, objectiveAttraction_,
-        intensification_, random_ };
+    assert(improvement_ || !improvements_.empty());
+
+    auto state = McoState{ problem, maxPheromone_, minPheromone_, maxPheromone_, pheromoneAttraction_, candidates_ };
     auto best = Solution{ problem, {}, std::numeric_limits<Value>::max() };
     auto candidates = std::vector<Solution>(mice_, best);
+    auto constructed = std::vector<Solution>(ReinforceStrategy::DARWIN == reinforceStrategy_ ? mice_ : 0, best);
     auto countdown = ticks_;
+    elapsedTicks_ = 0;
+
+    std::vector<Mouse> mice;
+    if (improvements_.empty())
+        mice.emplace_back(problem, state, objectiveAttraction_, intensification_, random_);
+    for (const auto& random : randoms_)
+        mice.emplace_back(problem, state, objectiveAttraction_, intensification_, random);
+
+    // construct and improve the tour of one mouse, without touching the pheromones
+    const auto run = [&](int thread, std::size_t i)
+    {
+        auto& improvement = improvements_.empty() ? *improvement_ : *improvements_[thread];
+        Solution tour = mice[thread].construct();
+        if (ReinforceStrategy::DARWIN == reinforceStrategy_)
+            constructed[i] = tour;
+
+        candidates[i] = improvement.search(std::move(tour));
+    };
 
     while (countdown-- > 0) {
+        if (improvements_.empty()) {
+            for (std::size_t i = 0; i < mice_; i++)
+                run(0, i);
+        }
+        else {
+            const auto seed = (*random_)();
+            pool_->parallelFor(mice_, [&](int thread, std::size_t i)
+                {
+                    auto seeds = std::seed_seq{ static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(i) };
+                    randoms_[thread]->seed(seeds);
+                    run(thread, i);
+                });
+        }
+
         for (std::size_t i = 0; i < mice_; i++) {
-            const auto constructed = mouse.construct();
-            const auto improved = improvement_->search(std::move(constructed));
-            state.reinforce(ReinforceStrategy::DARWIN == reinforceStrategy_ ? constructed : improved);
-            candidates[i] = std::move(improved);
+            state.reinforce(ReinforceStrategy::DARWIN == reinforceStrategy_ ? constructed[i] : candidates[i]);
 
             if (candidates[i] < best) {
                 best = candidates[i];
@@ -172,9 +620,14 @@ Solution Mco::search(const Problem& problem)
         }
 
         state.reinforce(best, elitism_); // best known solution gets extra pheromones
-        state.update();
-        state.evaporate(evaporation_);
+        state.update(evaporation_);
+        elapsedTicks_++;
     }
 
     return best;
 }
+
+int Mco::elapsedTicks() const noexcept
+{
+    return elapsedTicks_;
+}
@@ -5,11 +5,16 @@ module;
 
 #include <vector>
 #include <memory>
+#include <span>
+#include <utility>
+#include <cstdint>
+#include <functional>
 
 export module mco;
 
 import cbtsp;
 import local;
+import util;
 
 export using Pheromone = float;
 
@@ -24,8 +29,15 @@ export enum class ReinforceStrategy
 
 /**
  * Models a state in the MCO search while it is underway.
+ *
+ * Pheromones are only stored explicitly for the real edges of the problem and for the
+ * other edges which mice have reinforced. All other edges share one background level,
+ * which evolves like the level of an edge that is never reinforced. Reinforced edges
+ * whose level has decayed to within a small tolerance of the background level are dropped again.
+ * The tolerance is relative to the background plus the largest reinforcement of the latest update,
+ * because with a lowest level of 0, both decay at the same rate and never meet otherwise.
  */
-class McoState
+export class McoState
 {
 
 public:
@@ -37,52 +49,131 @@ public:
      * @param init: initial value of all pheromones
      * @param min: lowest pheromone level
      * @param max: highest pheromone level
+     * @param pheromoneAttraction: to which degree local pheromones attract
+     * @param candidates: number of candidate edges per vertex, 0 for all vertices
      */
     explicit McoState(const Problem& problem, Pheromone init,
-        Pheromone min, Pheromone max);
+        Pheromone min, Pheromone max, float pheromoneAttraction, std::size_t candidates = 0);
 
     /**
-     * Look up the pheromone in the lookup vector.
+     * Look up the pheromone of the edge.
      */
     Pheromone pheromone(Vertex a, Vertex b) const noexcept;
 
+    /**
+     * Look up the attraction of the pheromone, which is the pheromone
+     * raised to the power of the pheromone attraction.
+     */
+    Pheromone attraction(Vertex a, Vertex b) const noexcept;
+
+    /**
+     * Get the attraction of all edges which have no explicit pheromone level.
+     */
+    Pheromone backgroundAttraction() const noexcept;
+
+    /**
+     * Write the attractions of the explicit edges of the vertex into the row,
+     * which is indexed by the other endpoint, or the background attraction to clear them.
+     */
+    void scatter(std::vector<Pheromone>& row, Vertex vertex, bool set) const noexcept;
+
+    /**
+     * Get the number of edges with an explicit pheromone level, real or reinforced.
+     */
+    std::size_t explicitEdges() const noexcept;
+
+    /**
+     * Determine whether mice should only choose among the candidates of their current vertex.
+     */
+    bool restricted() const noexcept;
+
+    /**
+     * Get the candidates for the next step from the given vertex.
+     *
+     * These are the neighbors along the real edges with the lowest absolute value.
+     */
+    std::span<const Vertex> candidates(Vertex vertex) const noexcept;
+
     /**
      * Spread pheromones along the solution edges based on the objective value.
      *
      * @param solution: complete solution object
      * @param scale: multiply pheromone bonus by this factor
      */
-    void reinforce(const Solution& solution, float scale = 1.f) noexcept;
+    void reinforce(const Solution& solution, float scale = 1.f);
 
     /**
-     * Revert pheromone intensity everywhere.
+     * Apply pheromone changes everywhere, then revert pheromone intensity everywhere.
      *
-     * The updated intensity is the current intensity, with a certain fraction
+     * The reverted intensity is the updated intensity, with a certain fraction
      * replaced by the lowest pheromone intensity.
+     * The changes are applied only to the reinforced edges. Clamping, reversion and
+     * the refresh of the pheromone attractions happen in a single pass over the explicit edges.
      *
      * @param evaporation: fraction of lowest pheromone level
      */
-    void evaporate(float evaporation) noexcept;
-
-    /**
-     * Apply pheromone changes everywhere.
-     */
-    void update() noexcept;
+    void update(float evaporation) noexcept;
 
 private:
 
+    //! Reference from a vertex to an explicit edge.
+    struct Link
+    {
+        Vertex neighbor; //!< other endpoint of the edge
+        std::uint32_t edge; //!< id of the edge
+    };
+
     const Problem* problem_; //!< problem instance
     Pheromone min_; //!< lowest pheromone level
     Pheromone max_; //!< highest pheromone level
-    EdgeTable<Pheromone> pheromone_; //!< current pheromone levels for every edge
-    EdgeTable<Pheromone> delta_; //!< upcoming pheromone update
+    float pheromoneAttraction_; //!< exponent of the pheromone attractions
+    Pheromone background_; //!< pheromone level of all edges without an explicit level
+    Pheromone backgroundAttraction_; //!< background level raised to the pheromone attraction
+    std::vector<std::vector<Link>> links_; //!< explicit edges of each vertex: real edges by neighbor, then reinforced edges by neighbor
+    std::vector<std::pair<Vertex, Vertex>> ends_; //!< endpoints of each explicit edge
+    std::size_t realEdges_ = 0; //!< number of real edges, which come first in the explicit edges
+    std::vector<Pheromone> pheromone_; //!< current pheromone levels for every explicit edge
+    std::vector<Pheromone> attraction_; //!< current pheromone levels raised to the pheromone attraction, empty if linear
+    std::vector<Pheromone> delta_; //!< upcoming pheromone update, zero except on touched edges
+    std::vector<std::uint32_t> touched_; //!< explicit edges with an upcoming pheromone update
+    Pheromone reinforcement_ = 0.f; //!< largest pheromone change of the latest update with any changes
+    std::vector<std::size_t> candidateOffsets_; //!< start of the candidates of each vertex, empty if unrestricted
+    std::vector<Vertex> candidates_; //!< candidates of all vertices, one after another
+
+    static constexpr std::uint32_t none = static_cast<std::uint32_t>(-1); //!< id of edges without explicit level
+    static constexpr Pheromone dropTolerance = 1e-4f; //!< relative difference below which reinforced edges are dropped
+
+    /**
+     * Find the explicit edge between the vertices.
+     *
+     * @return: id of the edge, or `none`
+     */
+    std::uint32_t find(Vertex a, Vertex b) const noexcept;
+
+    /**
+     * Give the edge between the vertices an explicit pheromone level at the background level.
+     *
+     * @return: id of the new edge
+     */
+    std::uint32_t add(Vertex a, Vertex b);
+
+    /**
+     * Find the link from a to b among the reinforced links of a, or the position where it belongs.
+     */
+    std::vector<Link>::iterator reinforcedLink(Vertex a, Vertex b) noexcept;
+
+    /**
+     * Drop the explicit level of a reinforced edge, which must have no upcoming update.
+     * This moves the last explicit edge to the freed id.
+     */
+    void drop(std::uint32_t edge) noexcept;
 
 };
 
 /**
  * Models the behavior of a mouse in the colony.
  */
-class Mouse
+export class Mouse
 {
 
 public:
@@ -92,19 +183,23 @@ public:
      *
      * @param problem: CBTSP problem instance
      * @param state: search state with pheromone info
-     * @param pheromoneAttraction: to which degree local pheromones attract
      * @param objectiveAttraction: to which degree local objective value attracts
      * @param intensification: probability to outright select the best step
      * @param random: random number generator
      */
-    explicit Mouse(const Problem& problem, McoState& state,
-        float pheromoneAttraction, float objectiveAttraction,
+    explicit Mouse(const Problem& problem, McoState& state, float objectiveAttraction,
         float intensification, const std::shared_ptr<Random>& random) noexcept;
 
     /**
      * Traverse the problem to construct a solution.
      * Based on the final value of the solution, paths will be reinforced with a pheromone bonus.
      *
+     * The mouse builds the tour in its own vertex array, of which the prefix is the path
+     * traversed so far and the rest are the unvisited vertices. Unrestricted mice reverse the
+     * array between the next position and their chosen vertex, which keeps the same order of
+     * unvisited vertices as a two-edge exchange on a Solution would.
+     * Restricted mice swap the chosen vertex into place.
+     *
      * @return: the generated solution
      */
     Solution construct();
@@ -112,27 +207,104 @@ public:
 private:
 
     /**
-     * For the given partially traversed solution, use pheromone and projected
-     * visible benefit information to decide on the next Vertex step.
+     * Use pheromone and projected visible benefit information to decide on the next Vertex step
+     * among all unvisited vertices of the tour which is under construction.
      *
-     * @param solution: partially traversed solution object
+     * @param position: number of traversed vertices
+     * @return: position of the next vertex in the tour
      */
-    std::size_t decideNext(const Solution& solution, std::size_t position);
+    std::size_t decideNext(std::size_t position);
+
+    /**
+     * Like `decideNext`, but consider only the unvisited candidates of the current vertex.
+     */
+    std::size_t decideCandidate(std::size_t position);
+
+    /**
+     * Add the incentive of the step to the given tour position to the cumulative incentives.
+     * The attractions from the current vertex must be in the attraction row.
+     *
+     * @param to: next vertex
+     * @param value: tour value as the objective of the step
+     */
+    void addIncentive(Vertex to, Value value);
+
+    /**
+     * Choose one of the steps whose incentives were added, either the most incentivized
+     * or at random according to their incentives.
+     *
+     * @return: index of the step in the order in which they were added
+     */
+    std::size_t choose();
+
+    /**
+     * Compute the value of the tour under construction after a two-edge exchange
+     * between the start of the tour and the given position, like `Solution::twoOptValue`.
+     */
+    Value exchangeValue(std::size_t position) const noexcept;
+
+    /**
+     * Perform a two-edge exchange on the tour under construction, like `Solution::twoOpt`.
+     */
+    void exchange(std::size_t v1, std::size_t v2) noexcept;
+
+    /**
+     * Exchange the vertices at the given positions of the tour under construction.
+     */
+    void swap(std::size_t a, std::size_t b) noexcept;
+
+    /**
+     * Recompute the value of the edge leading to the vertex at the given position.
+     */
+    void refreshEdge(std::size_t position) noexcept;
+
+    /**
+     * Point the first and last rows to the current first and last vertex of the tour.
+     */
+    void refreshRows() noexcept;
+
+    /**
+     * Write the values of the real edges of the vertex into the row, or big-M to clear them.
+     */
+    void scatter(std::vector<Value>& row, Vertex vertex, bool set) const noexcept;
 
     const Problem* problem_; //!< problem info
     McoState* state_; //!< pheromone info
-    float pheromoneAttraction_; //!< pheromone attraction
     float objectiveAttraction_; //!< objective attraction
     float intensification_; //!< probability to outright select the best step
     std::shared_ptr<Random> random_; //!< random number generator
+    std::vector<double> cumulative_; //!< scratch: running sum of the incentives of the candidates, in double precision
+    std::size_t best_ = 0; //!< scratch: index of the first most incentivized candidate
+    Pheromone bestIncentive_ = 0.f; //!< scratch: incentive of the first most incentivized candidate
+    std::vector<std::size_t> slots_; //!< scratch: tour positions of the candidates
+    std::vector<Pheromone> attractionRow_; //!< scratch: attractions from the current vertex, background if none
+    std::vector<Vertex> tour_; //!< visited path, then unvisited vertices
+    std::vector<Value> edges_; //!< value of the edge leading to each position in the tour
+    std::vector<std::size_t> positions_; //!< restricted construction: position of each vertex in the tour
+    Value value_ = 0; //!< value of the tour
+    std::vector<Value> firstRow_; //!< values from the first vertex of the tour, big-M if none
+    std::vector<Value> lastRow_; //!< values from the last vertex of the tour, big-M if none
+    Vertex first_ = 0; //!< vertex whose values are in the first row
+    Vertex last_ = 0; //!< vertex whose values are in the last row
 
 };
 
+/**
+ * Creates an improvement heuristic which draws its random numbers from the given generator.
+ */
+export using ImprovementFactory = std::function<std::unique_ptr<LocalSearch>(const std::shared_ptr<Random>& random)>;
+
 /**
  * Mouse Colony Optimization implementation.
  *
  * This is a very basic Mouse Colony search heuristic.
  * It runs until it cannot find any improvement to the solution within a given time.
+ *
+ * The mice of a tick only read the pheromones, so in the parallel mode, they run concurrently.
+ * Every thread has its own mouse and improvement heuristic, and each mouse seeds the random
+ * number generator of its thread from a tick seed and its number. The pheromones are
+ * reinforced in the order of the mice after all of them have finished, so the search
+ * does not depend on the number of threads.
  */
 export class Mco : public Search
 {
@@ -154,12 +326,39 @@ public:
      * @param reinforceStrategy: from which found solution to reinforce pheromones
      * @param random: random number generator
      * @param improvement: improvement heuristic to apply after Mouse construction
+     * @param candidates: number of candidate edges per vertex, 0 for all vertices
+     */
+    explicit Mco(int ticks, int mice, float evaporation, float elitism,
+        float minPheromone, float maxPheromone,
+        float pheromoneAttraction, float objectiveAttraction,
+        float intensification, ReinforceStrategy reinforceStrategy,
+        const std::shared_ptr<Random>& random, std::unique_ptr<LocalSearch> improvement,
+        std::size_t candidates = 0) noexcept;
+
+    /**
+     * Construct the parallel search.
+     *
+     * @param ticks: number of iterations on a stagnated solution before termination
+     * @param mice: number of traversals within a tick to construct solution candidates
+     * @param evaporation: fraction of pheromone decrease per tick
+     * @param elitism: factor of pheromone contribution of best solution so far
+     * @param minPheromone: minimum pheromone value
+     * @param maxPheromone: maximum and initial pheromone value
+     * @param pheromoneAttraction: to which degree local pheromones attract
+     * @param objectiveAttraction: to which degree local objective value attracts
+     * @param intensification: chance of choosing best step
+     * @param reinforceStrategy: from which found solution to reinforce pheromones
+     * @param random: random number generator for the tick seeds
+     * @param buildImprovement: factory for the improvement heuristic of each thread
+     * @param threads: number of threads
+     * @param candidates: number of candidate edges per vertex, 0 for all vertices
      */
     explicit Mco(int ticks, int mice, float evaporation, float elitism,
         float minPheromone, float maxPheromone,
         float pheromoneAttraction, float objectiveAttraction,
         float intensification, ReinforceStrategy reinforceStrategy,
-        const std::shared_ptr<Random>& random, std::unique_ptr<LocalSearch> improvement) noexcept;
+        const std::shared_ptr<Random>& random, const ImprovementFactory& buildImprovement,
+        int threads, std::size_t candidates = 0);
 
     /**
      * Execute the MCO scheme for the given problem.
@@ -169,6 +368,11 @@ public:
      */
     virtual Solution search(const Problem& problem) override;
 
+    /**
+     * Get the number of ticks which the last search ran for.
+     */
+    int elapsedTicks() const noexcept;
+
 private:
 
     int ticks_; // number of iterations on a stagnated solution before termination
@@ -183,5 +387,10 @@ private:
     ReinforceStrategy reinforceStrategy_; // from which found solution to reinforce pheromones
     std::shared_ptr<Random> random_; //!< random number generator
     std::unique_ptr<LocalSearch> improvement_; //!< improvement heuristic
+    std::size_t candidates_; //!< number of candidate edges per vertex, 0 for all vertices
+    int elapsedTicks_ = 0; //!< number of ticks in the last search
+    std::vector<std::shared_ptr<Random>> randoms_; //!< parallel mode: random number generator of each thread
+    std::vector<std::unique_ptr<LocalSearch>> improvements_; //!< parallel mode: improvement heuristic of each thread
+    std::unique_ptr<ThreadPool> pool_; //!< parallel mode: threads which run the mice of every tick
 
 };
@@ -7,8 +7,16 @@ module;
 #include <chrono>
 #include <iostream>
 #include <fstream>
-#include <streambuf>
 #include <ios>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <algorithm>
+#include <numeric>
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <cstdint>
 #include <cassert>
 
 module setup;
@@ -24,21 +32,22 @@ import util;
 
 Problem readProblemFile(std::filesystem::path filePath)
 {
-    auto stream = std::ifstream{ filePath };
-    std::string contents;
+    auto file = std::make_shared<const MappedFile>(filePath);
 
-    stream.seekg(0, std::ios::end);
-    contents.reserve(narrow_cast<std::size_t>(static_cast<std::streamoff>(stream.tellg())));
-    stream.seekg(0, std::ios::beg);
+    if (Problem::isBinary(file->view()))
+        return Problem::fromBinary(move(file)); // the problem keeps the file mapped
 
-    contents.assign((std::istreambuf_iterator<char>(stream)),
-        std::istreambuf_iterator<char>());
+    return Problem::fromText(file->view());
+}
+
+void writeBinaryProblemFile(const Problem& problem, std::filesystem::path filePath)
+{
+    auto stream = std::ofstream{ filePath, std::ios_base::out | std::ios_base::binary }; // overwrite
+    problem.writeBinary(stream);
     stream.close();
 
     if (!stream)
-        throw std::runtime_error("Error reading problem from " + filePath.string());
-
-    return Problem::fromText(contents);
+        throw std::runtime_error("Error writing problem to " + filePath.string());
 }
 
 void writeResults(const Statistics& statistics, std::filesystem::path solutionPath, std::filesystem::path statsOutPath)
@@ -69,19 +78,119 @@ void writeResults(const Statistics& statistics, std::filesystem::path solutionPa
         throw std::runtime_error("Error writing stats to " + statsOutPath.string());
 }
 
+void measureBatch(const std::vector<std::filesystem::path>& inputFiles, const SearchFactory& buildSearch,
+    int samples, int threads, std::uint64_t seed,
+    const std::function<void(const std::filesystem::path&, const Statistics&)>& complete)
+{
+    assert(samples > 0);
+
+    using Clock = std::chrono::high_resolution_clock;
+
+    // results of the runs on one input file
+    struct Instance
+    {
+        std::shared_ptr<const Problem> problem;
+        std::vector<std::optional<Solution>> solutions;
+        std::vector<Clock::duration> runtimes;
+        std::atomic<int> remaining; //!< number of runs which are not done yet
+    };
+
+    auto scheduler = WorkStealingScheduler(workerThreads(threads));
+    auto instances = std::vector<Instance>(inputFiles.size());
+    std::mutex completeMutex;
+
+    // every thread reuses its search object for the runs on the same instance
+    struct Worker
+    {
+        const Instance* instance = nullptr;
+        std::shared_ptr<Random> random;
+        std::unique_ptr<Search> search;
+    };
+
+    auto workers = std::vector<Worker>(scheduler.threads());
+
+    const auto runTask = [&](std::size_t k, int i)
+    {
+        return [&, k, i](int thread)
+        {
+            auto& instance = instances[k];
+            auto& worker = workers[thread];
+            if (&instance != worker.instance) {
+                worker.random = std::make_shared<Random>();
+                worker.search = buildSearch(worker.random);
+                worker.instance = &instance;
+            }
+
+            // every sample has its own random stream
+            auto seeds = std::seed_seq{ static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32),
+                static_cast<std::uint32_t>(i) };
+            worker.random->seed(seeds);
+
+            const auto start = Clock::now();
+            instance.solutions[i].emplace(worker.search->search(*instance.problem));
+            const auto stop = Clock::now();
+            instance.runtimes[i] = stop - start;
+
+            if (0 != --instance.remaining)
+                return;
+
+            {
+                auto statistics = Statistics{ inputFiles[k].stem().string() };
+                for (int j = 0; j < samples; j++)
+                    statistics.record(*instance.solutions[j], instance.runtimes[j]);
+
+                const auto lock = std::lock_guard{ completeMutex };
+                complete(inputFiles[k], statistics);
+            }
+
+            // the solutions refer to the problem, so they go first
+            instance.solutions = {};
+            instance.problem.reset();
+        };
+    };
+
+    const auto loadTask = [&](std::size_t k)
+    {
+        return [&, k](int thread)
+        {
+            auto& instance = instances[k];
+            instance.problem = std::make_shared<const Problem>(readProblemFile(inputFiles[k]));
+            instance.solutions.resize(samples);
+            instance.runtimes.resize(samples);
+            instance.remaining = samples;
+
+            // the loading thread takes the first runs itself, others steal the last ones
+            for (int i = samples - 1; i >= 0; i--)
+                scheduler.spawn(thread, runTask(k, i));
+        };
+    };
+
+    // larger files first, dealt round-robin so that every thread starts with the largest of its share
+    auto order = std::vector<std::size_t>(inputFiles.size());
+    std::iota(order.begin(), order.end(), std::size_t{ 0 });
+    std::ranges::stable_sort(order, std::greater<>{},
+        [&inputFiles](std::size_t k) { return std::filesystem::file_size(inputFiles[k]); });
+
+    for (std::size_t n = order.size(); n > 0; n--)
+        scheduler.spawn(static_cast<int>((n - 1) % scheduler.threads()), loadTask(order[n - 1]));
+
+    scheduler.run();
+}
+
 SearchBuilder::SearchBuilder(Configuration::Algorithm algorithm,
-    Configuration::StepFunction stepFunction,
+    Configuration::StepFunction stepFunction, TourLayout tourLayout, bool dontLookBits, DeltaStore deltaStore,
     int iterations, int popsize, float evaporation, float elitism,
     Pheromone minPheromone, Pheromone maxPheromone,
     float pheromoneAttraction, float objectiveAttraction,
-    float intensification, ReinforceStrategy reinforceStrategy,
+    float intensification, ReinforceStrategy reinforceStrategy, int candidates, int searchThreads,
     const std::shared_ptr<Random>& random) noexcept
-    : algorithm_(algorithm), stepFunction_(stepFunction),
+    : algorithm_(algorithm), stepFunction_(stepFunction), tourLayout_(tourLayout), dontLookBits_(dontLookBits),
+    deltaStore_(deltaStore),
     iterations_(iterations), popsize_(popsize), evaporation_(evaporation), elitism_(elitism),
     minPheromone_(minPheromone), maxPheromone_(maxPheromone),
     pheromoneAttraction_(pheromoneAttraction), objectiveAttraction_(objectiveAttraction),
-    intensification_(intensification), reinforceStrategy_(reinforceStrategy),
-    random_(random)
+    intensification_(intensification), reinforceStrategy_(reinforceStrategy), candidates_(candidates),
+    searchThreads_(searchThreads), random_(random)
 {
 }
 
@@ -95,22 +204,26 @@ std::unique_ptr<Search> SearchBuilder::buildSearch() const
     case Configuration::Algorithm::RAND_CONSTRUCTION:
         return std::make_unique<ConstructionSearch>(buildRandomConstruction());
 
+    case Configuration::Algorithm::BAL_CONSTRUCTION:
+        return std::make_unique<ConstructionSearch>(buildBalancedConstruction());
+
     case Configuration::Algorithm::LOCAL_SEARCH:
         return std::make_unique<StandaloneLocalSearch>(buildDeterministicConstruction(),
-            buildStep(buildFullNeighborhood()));
+            buildDescentStep(), tourLayout_);
 
     case Configuration::Algorithm::GRASP:
-        return std::make_unique<Grasp>(buildRandomConstruction(),
-            buildImprovement(), iterations_);
+        return std::make_unique<Grasp>([this]() { return buildGraspWorker(); },
+            iterations_, workerThreads(searchThreads_), random_);
 
     case Configuration::Algorithm::VND:
-        return std::make_unique<Vnd>(buildRandomConstruction(), buildVndSteps());
+        return std::make_unique<Vnd>(buildRandomConstruction(), buildVndSteps(), tourLayout_);
 
     case Configuration::Algorithm::MCO:
         return std::make_unique<Mco>(iterations_, popsize_, evaporation_, elitism_,
             minPheromone_, maxPheromone_, pheromoneAttraction_, objectiveAttraction_,
             intensification_, reinforceStrategy_,
-            random_, buildImprovement());
+            random_, [this](const std::shared_ptr<Random>& random) { return buildImprovement(random); },
+            workerThreads(searchThreads_), candidates_);
 
     default:
         assert(0);
@@ -119,6 +232,13 @@ std::unique_ptr<Search> SearchBuilder::buildSearch() const
     }
 }
 
+std::unique_ptr<Search> SearchBuilder::buildSearch(const std::shared_ptr<Random>& random) const
+{
+    auto builder = *this;
+    builder.random_ = random;
+    return builder.buildSearch();
+}
+
 std::unique_ptr<DeterministicConstruction> SearchBuilder::buildDeterministicConstruction() const
 {
     auto selector = FarthestCitySelector();
@@ -133,29 +253,16 @@ std::unique_ptr<RandomConstruction> SearchBuilder::buildRandomConstruction() con
     return std::make_unique<RandomConstruction>(selector, inserter);
 }
 
-std::unique_ptr<Neighborhood> SearchBuilder::buildFullNeighborhood() const
+std::unique_ptr<BalancedConstruction> SearchBuilder::buildBalancedConstruction() const
 {
-    return std::make_unique<TwoExchangeNeighborhood>();
+    auto selector = BalancedSelector();
+    auto inserter = BestTourInserter();
+    return std::make_unique<BalancedConstruction>(selector, inserter);
 }
 
-std::unique_ptr<Step> SearchBuilder::buildStep(std::unique_ptr<Neighborhood> neighborhood) const
+std::unique_ptr<TwoExchangeNeighborhood> SearchBuilder::buildFullNeighborhood() const
 {
-    switch (stepFunction_) {
-
-    case Configuration::StepFunction::RANDOM:
-        return std::make_unique<StepRandom>(move(neighborhood), random_);
-
-    case Configuration::StepFunction::FIRST_IMPROVEMENT:
-        return std::make_unique<FirstImprovement>(move(neighborhood));
-
-    case Configuration::StepFunction::BEST_IMPROVEMENT:
-        return std::make_unique<BestImprovement>(move(neighborhood));
-
-    default:
-        assert(0);
-        return {};
-
-    }
+    return std::make_unique<TwoExchangeNeighborhood>();
 }
 
 std::vector<std::unique_ptr<Step>> SearchBuilder::buildVndSteps() const
@@ -167,7 +274,38 @@ std::vector<std::unique_ptr<Step>> SearchBuilder::buildVndSteps() const
     return steps;
 }
 
+std::unique_ptr<Step> SearchBuilder::buildDescentStep() const
+{
+    if (dontLookBits_)
+        return std::make_unique<DontLookImprovement>(buildFullNeighborhood());
+    else
+        return buildStep(buildFullNeighborhood());
+}
+
 std::unique_ptr<LocalSearch> SearchBuilder::buildImprovement() const
 {
-    return std::make_unique<LocalSearch>(buildStep(buildFullNeighborhood()));
+    return std::make_unique<LocalSearch>(buildDescentStep(), tourLayout_);
+}
+
+std::unique_ptr<LocalSearch> SearchBuilder::buildImprovement(const std::shared_ptr<Random>& random) const
+{
+    auto builder = *this;
+    builder.random_ = random;
+    return builder.buildImprovement();
+}
+
+int SearchBuilder::stepThreads() const noexcept
+{
+    if (Configuration::Algorithm::LOCAL_SEARCH == algorithm_ || Configuration::Algorithm::VND == algorithm_)
+        return workerThreads(searchThreads_);
+
+    return 1;
+}
+
+GraspWorker SearchBuilder::buildGraspWorker() const
+{
+    // the worker's heuristics share their own random number generator
+    auto builder = *this;
+    builder.random_ = std::make_shared<Random>();
+    return { builder.buildRandomConstruction(), builder.buildImprovement(), builder.random_ };
 }
@@ -9,12 +9,16 @@ module;
 #include <random>
 #include <memory>
 #include <vector>
+#include <functional>
+#include <cstdint>
+#include <cassert>
 
 export module setup;
 
 import cbtsp;
 import construction;
 import local;
+import grasp;
 import mco;
 import config;
 import statistics;
@@ -22,11 +26,23 @@ import statistics;
 /**
  * Read a problem from the given input file.
  *
+ * The file may be in text format or in the precompiled binary format.
+ *
  * @param filePath: input file path
  * @return: problem object
  */
 export Problem readProblemFile(std::filesystem::path filePath);
 
+/**
+ * Write a problem to the given output file in binary format.
+ *
+ * The contents of the file, if it exists, will be overwritten.
+ *
+ * @param problem: problem object
+ * @param filePath: output file path
+ */
+export void writeBinaryProblemFile(const Problem& problem, std::filesystem::path filePath);
+
 /**
  * Write the results of a run to the appropriate output files.
  *
@@ -42,6 +58,29 @@ export Problem readProblemFile(std::filesystem::path filePath);
 export void writeResults(const Statistics& statistics,
     std::filesystem::path solutionPath, std::filesystem::path statsOutPath);
 
+/**
+ * Execute searches on several problem instances repeatedly as one batch of tasks.
+ *
+ * Loading an instance and every run on it are separate tasks for a work-stealing scheduler,
+ * so threads which run out of work on one instance help with the others.
+ * The largest input files are loaded first, and the runs on an instance begin as soon as it is loaded
+ * while other threads are still loading. An instance is released after its last run.
+ *
+ * The runs are seeded like Statistics::measure with the same master seed,
+ * so every instance has the same results as when it is measured on its own.
+ *
+ * @param inputFiles: problem instance files
+ * @param buildSearch: factory for the search heuristic
+ * @param samples: number of repetitions to sample per instance
+ * @param threads: number of worker threads, 0 for one per hardware thread
+ * @param seed: master seed for the random number generators
+ * @param complete: called with the input file and the statistical record of each instance
+ *                  as soon as all its runs are done; calls do not overlap
+ */
+export void measureBatch(const std::vector<std::filesystem::path>& inputFiles, const SearchFactory& buildSearch,
+    int samples, int threads, std::uint64_t seed,
+    const std::function<void(const std::filesystem::path&, const Statistics&)>& complete);
+
 /**
  * This class can wire up the correct search algorithm from the program configuration.
  */
@@ -55,6 +94,9 @@ public:
      *
      * @param algorithm: choice of search heuristic
      * @param stepFunction: choice of neighborhood step function
+     * @param tourLayout: tour data structure for local search
+     * @param dontLookBits: whether local search only scans around recently changed vertices
+     * @param deltaStore: where best improvement keeps the move values across steps
      * @param iterations: number of iterations for GRASP and MCO
      * @param popsize: number of mice in an iteration of MCO
      * @param evaporation: MCO: fraction of pheromone decrease per tick
@@ -65,14 +107,16 @@ public:
      * @param objectiveAttraction: MCO: to which degree local objective value attracts
      * @param intensification: MCO: chance of choosing best step
      * @param reinforceStrategy: MCO: pheromone update source
+     * @param candidates: MCO: number of candidate edges per vertex, 0 for all vertices
+     * @param searchThreads: number of worker threads within one search, 0 for one per hardware thread
      * @param random: random number generator
      */
     explicit SearchBuilder(Configuration::Algorithm algorithm,
-        Configuration::StepFunction stepFunction,
+        Configuration::StepFunction stepFunction, TourLayout tourLayout, bool dontLookBits, DeltaStore deltaStore,
         int iterations, int popsize, float evaporation, float elitism,
         Pheromone minPheromone, Pheromone maxPheromone,
         float pheromoneAttraction, float objectiveAttraction,
-        float intensification, ReinforceStrategy reinforceStrategy,
+        float intensification, ReinforceStrategy reinforceStrategy, int candidates, int searchThreads,
         const std::shared_ptr<Random>& random) noexcept;
 
     /**
@@ -82,11 +126,23 @@ public:
      */
     std::unique_ptr<Search> buildSearch() const;
 
+    /**
+     * Construct the search object with the given parameters,
+     * but with the given random number generator instead of the configured one.
+     *
+     * @param random: random number generator
+     * @return: the search algorithm object
+     */
+    std::unique_ptr<Search> buildSearch(const std::shared_ptr<Random>& random) const;
+
 private:
 
     // configurable search parameters
     Configuration::Algorithm algorithm_;
     Configuration::StepFunction stepFunction_;
+    TourLayout tourLayout_; //!< tour data structure for local search
+    bool dontLookBits_; //!< whether local search uses don't-look bits
+    DeltaStore deltaStore_; //!< where best improvement keeps the move values
     int iterations_;
     int popsize_;
     float evaporation_; // MCO: fraction of pheromone decrease per tick
@@ -97,13 +153,51 @@ private:
     float objectiveAttraction_; // MCO: to which degree local objective value attracts
     float intensification_; //!< MCO: chance of choosing best step
     ReinforceStrategy reinforceStrategy_; // MCO: pheromone update source
+    int candidates_; //!< MCO: number of candidate edges per vertex
+    int searchThreads_; //!< number of worker threads within one search, 0 for one per hardware thread
     std::shared_ptr<Random> random_;
 
     std::unique_ptr<DeterministicConstruction> buildDeterministicConstruction() const;
     std::unique_ptr<RandomConstruction> buildRandomConstruction() const;
-    std::unique_ptr<Neighborhood> buildFullNeighborhood() const;
-    std::unique_ptr<Step> buildStep(std::unique_ptr<Neighborhood> neighborhood) const;
+    std::unique_ptr<BalancedConstruction> buildBalancedConstruction() const;
+    std::unique_ptr<TwoExchangeNeighborhood> buildFullNeighborhood() const;
     std::vector<std::unique_ptr<Step>> buildVndSteps() const;
+    std::unique_ptr<Step> buildDescentStep() const;
     std::unique_ptr<LocalSearch> buildImprovement() const;
+    std::unique_ptr<LocalSearch> buildImprovement(const std::shared_ptr<Random>& random) const;
+
+    /**
+     * Get the number of threads for the scan of a best improvement step.
+     * Only searches which do not run heuristics in parallel already split their scans.
+     */
+    int stepThreads() const noexcept;
+    GraspWorker buildGraspWorker() const;
+
+    /**
+     * Create the configured step function, compiled for the concrete neighborhood type.
+     */
+    template<typename N>
+    std::unique_ptr<Step> buildStep(std::unique_ptr<N> neighborhood) const;
 
 };
+
+template<typename N>
+std::unique_ptr<Step> SearchBuilder::buildStep(std::unique_ptr<N> neighborhood) const
+{
+    switch (stepFunction_) {
+
+    case Configuration::StepFunction::RANDOM:
+        return std::make_unique<StepRandom>(std::move(neighborhood), random_);
+
+    case Configuration::StepFunction::FIRST_IMPROVEMENT:
+        return std::make_unique<BasicFirstImprovement<N>>(std::move(neighborhood));
+
+    case Configuration::StepFunction::BEST_IMPROVEMENT:
+        return std::make_unique<BasicBestImprovement<N>>(std::move(neighborhood), deltaStore_, stepThreads());
+
+    default:
+        assert(0);
+        return {};
+
+    }
+}
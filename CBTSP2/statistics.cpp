@@ -6,9 +6,13 @@ module;
 #include <cmath>
 #include <cassert>
 #include <chrono>
+#include <optional>
+#include <random>
 
 module statistics;
 
+import util;
+
 // ---- helpers ----
 
 bool isFeasible(const Solution& s)
@@ -138,3 +142,42 @@ Statistics Statistics::measure(const std::string& name, Search& search, const Pr
 
     return statistics;
 }
+
+Statistics Statistics::measure(const std::string& name, const SearchFactory& buildSearch,
+    const Problem& problem, int samples, int threads, std::uint64_t seed)
+{
+    assert(samples > 0);
+
+    threads = std::min(workerThreads(threads), samples);
+
+    std::vector<std::optional<Solution>> solutions(samples);
+    std::vector<Runtime> runtimes(samples);
+    std::vector<std::shared_ptr<Random>> randoms(threads);
+    std::vector<std::unique_ptr<Search>> searches(threads);
+
+    parallelFor(samples, threads, [&](int thread, std::size_t i)
+        {
+            auto& random = randoms[thread];
+            if (!searches[thread]) {
+                random = std::make_shared<Random>();
+                searches[thread] = buildSearch(random);
+            }
+
+            // every sample has its own random stream
+            auto seeds = std::seed_seq{ static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32),
+                static_cast<std::uint32_t>(i) };
+            random->seed(seeds);
+
+            const auto start = Clock::now();
+            solutions[i].emplace(searches[thread]->search(problem));
+            const auto stop = Clock::now();
+            runtimes[i] = stop - start;
+        });
+
+    Statistics statistics{ name };
+
+    for (int i = 0; i < samples; i++)
+        statistics.record(*solutions[i], runtimes[i]);
+
+    return statistics;
+}
@@ -5,6 +5,10 @@ module;
 
 #include <chrono>
 #include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <cstdint>
 
 export module statistics;
 
@@ -13,6 +17,11 @@ import cbtsp;
 using Clock = std::chrono::high_resolution_clock;
 using Runtime = Clock::duration;
 
+/**
+ * Creates a new search object which draws its random numbers from the given generator.
+ */
+export using SearchFactory = std::function<std::unique_ptr<Search>(const std::shared_ptr<Random>& random)>;
+
 /**
  * Keeps records about the solutions which are produced by the algorithms.
  *
@@ -98,6 +107,25 @@ public:
      */
     static Statistics measure(const std::string& name, Search& search, const Problem& problem, int samples);
 
+    /**
+     * Execute searches on the given problem instance repeatedly on multiple threads
+     * and enter relevant results into the statistical record.
+     *
+     * Every worker thread builds its own search object with its own random number generator.
+     * Before each sample, the generator is seeded from the master seed and the sample number,
+     * so the results do not depend on the number of threads or on which thread runs a sample.
+     * They are recorded in the order of the samples.
+     *
+     * @param name: identifying name of the statistical record
+     * @param buildSearch: factory for the search heuristic
+     * @param problem: problem instance
+     * @param samples: number of repetitions to sample
+     * @param threads: number of worker threads, 0 for one per hardware thread
+     * @param seed: master seed for the random number generators
+     */
+    static Statistics measure(const std::string& name, const SearchFactory& buildSearch,
+        const Problem& problem, int samples, int threads, std::uint64_t seed);
+
 private:
 
     std::string name_;
@@ -0,0 +1,198 @@
+module;
+
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+
+module cbtsp;
+
+TwoLevelTour::TwoLevelTour(const std::vector<Vertex>& vertices)
+    : idealSize_(std::max<std::size_t>(8, static_cast<std::size_t>(std::sqrt(vertices.size()))))
+{
+    const std::size_t maxVertex = vertices.empty() ? 0 : *std::ranges::max_element(vertices);
+    slotOf_.resize(maxVertex + 1);
+    segmentOf_.resize(maxVertex + 1);
+    rebuild(vertices);
+}
+
+std::size_t TwoLevelTour::size() const noexcept
+{
+    return slots_.size();
+}
+
+Vertex TwoLevelTour::at(std::size_t pos) const noexcept
+{
+    assert(pos < size());
+
+    const std::size_t rank = std::ranges::upper_bound(starts_, pos) - starts_.begin() - 1;
+    return slots_[slotAt(segments_[order_[rank]], pos - starts_[rank])];
+}
+
+std::size_t TwoLevelTour::position(Vertex vertex) const noexcept
+{
+    const Segment& segment = segments_[segmentOf_[vertex]];
+    return starts_[segment.rank] + offsetOf(segment, slotOf_[vertex]);
+}
+
+Vertex TwoLevelTour::next(Vertex vertex) const noexcept
+{
+    const Segment& segment = segments_[segmentOf_[vertex]];
+    const std::size_t offset = offsetOf(segment, slotOf_[vertex]) + 1;
+
+    if (offset < segment.end - segment.begin)
+        return slots_[slotAt(segment, offset)];
+
+    const Segment& following = segments_[order_[(segment.rank + 1) % order_.size()]];
+    return slots_[slotAt(following, 0)];
+}
+
+Vertex TwoLevelTour::prev(Vertex vertex) const noexcept
+{
+    const Segment& segment = segments_[segmentOf_[vertex]];
+    const std::size_t offset = offsetOf(segment, slotOf_[vertex]);
+
+    if (offset > 0)
+        return slots_[slotAt(segment, offset - 1)];
+
+    const Segment& preceding = segments_[order_[(segment.rank + order_.size() - 1) % order_.size()]];
+    return slots_[slotAt(preceding, preceding.end - preceding.begin - 1)];
+}
+
+bool TwoLevelTour::between(Vertex a, Vertex b, Vertex c) const noexcept
+{
+    const std::size_t pa = position(a);
+    const std::size_t pb = position(b);
+    const std::size_t pc = position(c);
+
+    if (pa <= pc)
+        return pa <= pb && pb <= pc;
+    else
+        return pb >= pa || pb <= pc; // wraps around the tour end
+}
+
+void TwoLevelTour::reverse(std::size_t low, std::size_t high)
+{
+    assert(low <= high);
+    assert(high <= size());
+
+    if (high - low < 2)
+        return;
+
+    // every reversal may add two segments, which eventually make the segment list long
+    if (order_.size() + 2 > 2 * (size() / idealSize_ + 1)) {
+        copyTo(scratch_);
+        rebuild(scratch_);
+    }
+
+    const std::size_t first = splitAt(low);
+    const std::size_t last = high < size() ? splitAt(high) : order_.size();
+
+    std::reverse(order_.begin() + first, order_.begin() + last);
+    std::size_t start = low;
+
+    for (std::size_t rank = first; rank < last; rank++) {
+        Segment& segment = segments_[order_[rank]];
+        segment.reversed = !segment.reversed;
+        segment.rank = rank;
+        starts_[rank] = start;
+        start += segment.end - segment.begin;
+    }
+}
+
+void TwoLevelTour::copyTo(std::vector<Vertex>& sequence) const
+{
+    sequence.clear();
+    sequence.reserve(size());
+
+    for (const std::size_t id : order_) {
+        const Segment& segment = segments_[id];
+        const auto begin = slots_.begin() + segment.begin;
+        const auto end = slots_.begin() + segment.end;
+
+        if (segment.reversed)
+            sequence.insert(sequence.end(), std::make_reverse_iterator(end), std::make_reverse_iterator(begin));
+        else
+            sequence.insert(sequence.end(), begin, end);
+    }
+}
+
+void TwoLevelTour::rebuild(const std::vector<Vertex>& vertices)
+{
+    slots_ = vertices;
+    segments_.clear();
+    order_.clear();
+    starts_.clear();
+
+    for (std::size_t begin = 0; begin < slots_.size(); begin += idealSize_) {
+        const std::size_t end = std::min(begin + idealSize_, slots_.size());
+        const std::size_t id = segments_.size();
+        segments_.push_back({ begin, end, id, false });
+        order_.push_back(id);
+        starts_.push_back(begin);
+
+        for (std::size_t slot = begin; slot < end; slot++) {
+            slotOf_[slots_[slot]] = slot;
+            segmentOf_[slots_[slot]] = id;
+        }
+    }
+}
+
+std::size_t TwoLevelTour::splitAt(std::size_t pos)
+{
+    assert(pos < size());
+
+    const std::size_t rank = std::ranges::upper_bound(starts_, pos) - starts_.begin() - 1;
+    if (starts_[rank] == pos)
+        return rank;
+
+    const std::size_t id = order_[rank];
+    const Segment segment = segments_[id];
+    const std::size_t headLength = pos - starts_[rank];
+    const std::size_t tailLength = segment.end - segment.begin - headLength;
+
+    // slot ranges of the two parts in tour order
+    Segment head = segment;
+    Segment tail = segment;
+
+    if (segment.reversed) {
+        head.begin = segment.end - headLength;
+        tail.end = head.begin;
+    }
+    else {
+        head.end = segment.begin + headLength;
+        tail.begin = head.end;
+    }
+
+    head.rank = rank;
+    tail.rank = rank + 1;
+
+    // the smaller part gets a new segment, so that fewer vertices must be re-assigned
+    const std::size_t newId = segments_.size();
+    const bool moveHead = headLength < tailLength;
+    segments_[id] = moveHead ? tail : head;
+    segments_.push_back(moveHead ? head : tail);
+
+    const Segment& moved = segments_.back();
+    for (std::size_t slot = moved.begin; slot < moved.end; slot++)
+        segmentOf_[slots_[slot]] = newId;
+
+    order_.insert(order_.begin() + rank + (moveHead ? 0 : 1), newId);
+    starts_.insert(starts_.begin() + rank + 1, pos);
+
+    for (std::size_t r = rank + 2; r < order_.size(); r++)
+        segments_[order_[r]].rank = r;
+
+    return rank + 1;
+}
+
+std::size_t TwoLevelTour::offsetOf(const Segment& segment, std::size_t slot) noexcept
+{
+    return segment.reversed ? segment.end - 1 - slot : slot - segment.begin;
+}
+
+std::size_t TwoLevelTour::slotAt(const Segment& segment, std::size_t offset) noexcept
+{
+    return segment.reversed ? segment.end - 1 - offset : segment.begin + offset;
+}
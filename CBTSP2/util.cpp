@@ -1,6 +1,30 @@
 module;
 
 #include <string>
+#include <string_view>
+#include <filesystem>
+#include <stdexcept>
+#include <functional>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <deque>
+#include <condition_variable>
+#include <utility>
+#include <exception>
+#include <algorithm>
+#include <cassert>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 module util;
 
@@ -8,3 +32,339 @@ std::string format(std::string fmt)
 {
     return fmt;
 }
+
+int workerThreads(int threads) noexcept
+{
+    assert(threads >= 0);
+
+    if (threads > 0)
+        return threads;
+
+    return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+}
+
+void parallelFor(std::size_t count, int threads, const std::function<void(int, std::size_t)>& work)
+{
+    assert(threads > 0);
+
+    std::vector<std::exception_ptr> errors(threads);
+    std::atomic<std::size_t> next = 0;
+
+    const auto run = [&](int thread)
+    {
+        try {
+            for (std::size_t i = next++; i < count; i = next++)
+                work(thread, i);
+        }
+        catch (...) {
+            errors[thread] = std::current_exception();
+            next = count; // skip the remaining work
+        }
+    };
+
+    {
+        std::vector<std::jthread> workers;
+        for (int thread = 1; thread < threads; thread++)
+            workers.emplace_back(run, thread);
+
+        run(0);
+    }
+
+    for (const auto& error : errors) {
+        if (error)
+            std::rethrow_exception(error);
+    }
+}
+
+ThreadPool::ThreadPool(int threads)
+    : errors_(threads)
+{
+    assert(threads > 0);
+
+    for (int thread = 1; thread < threads; thread++)
+        workers_.emplace_back([this](int thread) { serve(thread); }, thread);
+}
+
+ThreadPool::~ThreadPool() noexcept
+{
+    {
+        const auto lock = std::lock_guard{ mutex_ };
+        stop_ = true;
+    }
+
+    start_.notify_all();
+    workers_.clear(); // join before the members which the workers use go away
+}
+
+int ThreadPool::threads() const noexcept
+{
+    return static_cast<int>(workers_.size()) + 1;
+}
+
+void ThreadPool::parallelFor(std::size_t count, const std::function<void(int, std::size_t)>& work)
+{
+    {
+        const auto lock = std::lock_guard{ mutex_ };
+        work_ = &work;
+        count_ = count;
+        next_ = 0;
+        busy_ = static_cast<int>(workers_.size());
+        generation_++;
+    }
+
+    start_.notify_all();
+    runItems(0);
+
+    {
+        auto lock = std::unique_lock{ mutex_ };
+        done_.wait(lock, [this]() { return 0 == busy_; });
+        work_ = nullptr;
+    }
+
+    // clear every slot, so that no exception of this loop surfaces in the next one
+    std::exception_ptr first;
+    for (auto& error : errors_) {
+        if (error && !first)
+            first = error;
+
+        error = nullptr;
+    }
+
+    if (first)
+        std::rethrow_exception(first);
+}
+
+void ThreadPool::serve(int thread)
+{
+    std::uint64_t generation = 0;
+
+    for (;;) {
+        {
+            auto lock = std::unique_lock{ mutex_ };
+            start_.wait(lock, [this, generation]() { return stop_ || generation != generation_; });
+
+            if (stop_)
+                return;
+
+            generation = generation_;
+        }
+
+        runItems(thread);
+
+        {
+            const auto lock = std::lock_guard{ mutex_ };
+            busy_--;
+        }
+
+        done_.notify_one();
+    }
+}
+
+void ThreadPool::runItems(int thread) noexcept
+{
+    try {
+        for (std::size_t i = next_++; i < count_; i = next_++)
+            (*work_)(thread, i);
+    }
+    catch (...) {
+        errors_[thread] = std::current_exception();
+        next_ = count_; // skip the remaining work
+    }
+}
+
+WorkStealingScheduler::WorkStealingScheduler(int threads)
+    : queues_(threads), queued_(0), pending_(0), stop_(false)
+{
+    assert(threads > 0);
+}
+
+int WorkStealingScheduler::threads() const noexcept
+{
+    return static_cast<int>(queues_.size());
+}
+
+void WorkStealingScheduler::spawn(int thread, Task task)
+{
+    assert(thread >= 0 && thread < threads());
+
+    {
+        const auto lock = std::lock_guard{ queues_[thread].mutex };
+        queues_[thread].tasks.push_back(std::move(task));
+    }
+
+    {
+        const auto lock = std::lock_guard{ mutex_ };
+        queued_++;
+        pending_++;
+    }
+
+    wake_.notify_one();
+}
+
+void WorkStealingScheduler::run()
+{
+    std::vector<std::exception_ptr> errors(threads());
+
+    {
+        std::vector<std::jthread> workers;
+        for (int thread = 1; thread < threads(); thread++)
+            workers.emplace_back([this, &errors](int thread) { work(thread, errors[thread]); }, thread);
+
+        work(0, errors[0]);
+    }
+
+    for (auto& queue : queues_)
+        queue.tasks.clear();
+
+    queued_ = 0;
+    pending_ = 0;
+    stop_ = false;
+
+    for (const auto& error : errors) {
+        if (error)
+            std::rethrow_exception(error);
+    }
+}
+
+bool WorkStealingScheduler::take(int thread, Task& task)
+{
+    // own tasks from the back, then other threads' tasks from the front
+    for (int i = 0; i < threads(); i++) {
+        auto& queue = queues_[(thread + i) % threads()];
+        const auto lock = std::lock_guard{ queue.mutex };
+
+        if (queue.tasks.empty())
+            continue;
+
+        if (0 == i) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+void WorkStealingScheduler::work(int thread, std::exception_ptr& error)
+{
+    for (;;) {
+        Task task;
+
+        if (!take(thread, task)) {
+            auto lock = std::unique_lock{ mutex_ };
+            wake_.wait(lock, [this]() { return queued_ > 0 || 0 == pending_ || stop_; });
+
+            if (0 == pending_ || stop_)
+                return;
+
+            continue; // another thread may be faster to take the new task
+        }
+
+        {
+            const auto lock = std::lock_guard{ mutex_ };
+            if (stop_)
+                return;
+
+            queued_--;
+        }
+
+        try {
+            task(thread);
+        }
+        catch (...) {
+            error = std::current_exception();
+            const auto lock = std::lock_guard{ mutex_ };
+            stop_ = true; // discard the remaining tasks
+        }
+
+        bool done;
+        {
+            const auto lock = std::lock_guard{ mutex_ };
+            done = 0 == --pending_ || stop_;
+        }
+
+        if (done)
+            wake_.notify_all();
+    }
+}
+
+MappedFile::MappedFile(const std::filesystem::path& path)
+    : data_(nullptr), size_(0)
+{
+    const auto error = std::runtime_error("Error mapping file " + path.string());
+
+    // the mapping remains valid after the file and mapping handles are closed
+#ifdef _WIN32
+    const HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (INVALID_HANDLE_VALUE == file)
+        throw error;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        throw error;
+    }
+
+    size_ = static_cast<std::size_t>(size.QuadPart);
+
+    if (size_ > 0) {
+        const HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping)
+            data_ = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+
+        if (mapping)
+            CloseHandle(mapping);
+    }
+
+    CloseHandle(file);
+#else
+    const int file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+        throw error;
+
+    const off_t size = lseek(file, 0, SEEK_END);
+    if (size < 0) {
+        close(file);
+        throw error;
+    }
+
+    size_ = static_cast<std::size_t>(size);
+
+    if (size_ > 0) {
+        void* mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, file, 0);
+        if (MAP_FAILED != mapping) {
+            madvise(mapping, size_, MADV_SEQUENTIAL);
+            data_ = static_cast<const char*>(mapping);
+        }
+    }
+
+    close(file);
+#endif
+
+    if (size_ > 0 && !data_)
+        throw error;
+}
+
+MappedFile::~MappedFile() noexcept
+{
+    if (!data_)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(data_);
+#else
+    munmap(const_cast<char*>(data_), size_);
+#endif
+}
+
+std::string_view MappedFile::view() const noexcept
+{
+    return { data_, size_ };
+}
@@ -4,10 +4,21 @@
 module;
 
 #include <string>
+#include <string_view>
+#include <filesystem>
 #include <ranges>
 #include <numeric>
 #include <type_traits>
 #include <stdexcept>
+#include <functional>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <thread>
+#include <atomic>
+#include <cstdint>
 #include <cassert>
 
 export module util;
@@ -68,3 +79,187 @@ Target narrow_cast(Source v)
 
     return r;
 }
+
+/**
+ * Determine the number of worker threads to use for a configured thread count.
+ *
+ * @param threads: configured number of threads, 0 for one per hardware thread
+ * @return: the number of threads, at least 1
+ */
+export int workerThreads(int threads) noexcept;
+
+/**
+ * Call the work function for every index in [0, count) on multiple threads.
+ *
+ * The threads take the indices in increasing order from a shared counter,
+ * so faster threads take more work. The calling thread works as thread 0.
+ * If the work throws, the remaining indices are skipped and the exception
+ * of the lowest thread is rethrown after all threads have finished.
+ *
+ * @param count: number of work items
+ * @param threads: number of threads, at least 1
+ * @param work: function to call as work(thread, index)
+ */
+export void parallelFor(std::size_t count, int threads, const std::function<void(int, std::size_t)>& work);
+
+/**
+ * Keeps a fixed number of threads alive to run one parallel loop after another.
+ *
+ * Loops which are called very often, like once per local search step,
+ * would spend much of their time starting and joining threads with `parallelFor`.
+ * The threads of the pool wait for the next loop instead.
+ */
+export class ThreadPool
+{
+
+public:
+
+    /**
+     * Start the worker threads. The thread which calls the loops works as thread 0.
+     *
+     * @param threads: number of threads, at least 1
+     */
+    explicit ThreadPool(int threads);
+
+    /**
+     * Stop and join the worker threads.
+     */
+    ~ThreadPool() noexcept;
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * Get the number of threads which run the loops.
+     */
+    int threads() const noexcept;
+
+    /**
+     * Call the work function for every index in [0, count) on the threads of the pool,
+     * with the same scheduling and exception handling as `parallelFor`.
+     *
+     * @param count: number of work items
+     * @param work: function to call as work(thread, index)
+     */
+    void parallelFor(std::size_t count, const std::function<void(int, std::size_t)>& work);
+
+private:
+
+    std::vector<std::jthread> workers_; //!< threads 1 and up
+    std::mutex mutex_; //!< guards the loop state below
+    std::condition_variable start_; //!< signals a new loop or the end of the pool
+    std::condition_variable done_; //!< signals that a worker has finished the loop
+    std::uint64_t generation_ = 0; //!< number of loops started so far
+    int busy_ = 0; //!< number of workers which have not finished the current loop
+    bool stop_ = false; //!< whether the pool shuts down
+    const std::function<void(int, std::size_t)>* work_ = nullptr; //!< work function of the current loop
+    std::size_t count_ = 0; //!< number of work items of the current loop
+    std::atomic<std::size_t> next_ = 0; //!< next work item of the current loop
+    std::vector<std::exception_ptr> errors_; //!< exception of each thread in the current loop
+
+    void serve(int thread);
+    void runItems(int thread) noexcept;
+
+};
+
+/**
+ * Runs tasks on a fixed number of threads, where idle threads steal work from busy ones.
+ *
+ * Every thread has its own deque of tasks. A thread takes its newest task first,
+ * so that tasks which another task spawned run while its data is still in the cache.
+ * A thread without tasks steals the oldest task of another thread.
+ * Tasks may spawn further tasks while the scheduler runs.
+ */
+export class WorkStealingScheduler
+{
+
+public:
+
+    using Task = std::function<void(int thread)>; //!< work function, called with the number of the running thread
+
+    /**
+     * Construct the scheduler with empty task deques.
+     *
+     * @param threads: number of threads, at least 1
+     */
+    explicit WorkStealingScheduler(int threads);
+
+    /**
+     * Get the number of threads which run the tasks.
+     */
+    int threads() const noexcept;
+
+    /**
+     * Add a task to the deque of the given thread.
+     * This may be called before running and from within tasks.
+     *
+     * @param thread: number of the thread which takes the task first
+     * @param task: work function
+     */
+    void spawn(int thread, Task task);
+
+    /**
+     * Run tasks until none are left. The calling thread works as thread 0.
+     * If a task throws, the remaining tasks are discarded and the exception
+     * of the lowest thread is rethrown after all threads have finished.
+     */
+    void run();
+
+private:
+
+    /**
+     * Task deque of one thread.
+     */
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<Queue> queues_; //!< one task deque per thread
+    std::mutex mutex_; //!< guards the counters below
+    std::condition_variable wake_; //!< signals new tasks and the end of the run
+    int queued_; //!< number of tasks in the deques
+    int pending_; //!< number of tasks which are queued or running
+    bool stop_; //!< whether a task has thrown
+
+    bool take(int thread, Task& task);
+    void work(int thread, std::exception_ptr& error);
+
+};
+
+/**
+ * Read-only memory mapping of a whole file.
+ *
+ * The file contents are available as a string view for as long as the object lives.
+ * This avoids copying the file into a buffer before parsing it.
+ */
+export class MappedFile
+{
+
+public:
+
+    /**
+     * Map the file at the given path into memory.
+     *
+     * @param path: path to the file
+     * @throw std::runtime_error: if the file cannot be opened or mapped
+     */
+    explicit MappedFile(const std::filesystem::path& path);
+
+    ~MappedFile() noexcept;
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * Get the contents of the file.
+     */
+    std::string_view view() const noexcept;
+
+private:
+
+    const char* data_; //!< start of the mapped file contents
+    std::size_t size_; //!< size of the file in bytes
+
+};
@@ -5,14 +5,16 @@ module;
 
 module vnd;
 
-Vnd::Vnd(std::unique_ptr<Construction> construction, std::vector<std::unique_ptr<Step>> steps) noexcept
-    : construction_(move(construction)), steps_(move(steps))
+Vnd::Vnd(std::unique_ptr<Construction> construction, std::vector<std::unique_ptr<Step>> steps,
+    TourLayout layout) noexcept
+    : construction_(move(construction)), steps_(move(steps)), layout_(layout)
 {
 }
 
 Solution Vnd::search(const Problem& problem)
 {
     Solution best = construction_->construct(problem);
+    best.setLayout(layout_);
     std::size_t level = 0;
 
     while (level < steps_.size()) {
@@ -28,5 +30,6 @@ Solution Vnd::search(const Problem& problem)
         }
     }
 
+    best.setLayout(TourLayout::ARRAY);
     return best;
 }
@@ -25,9 +25,11 @@ public:
      *
      * @param construction: construction heuristic for getting the initial solution from the instance
      * @param steps: step functions across neighborhood structures, from local to wide
+     * @param layout: tour data structure to use during the descent
      */
     explicit Vnd(std::unique_ptr<Construction> construction,
-        std::vector<std::unique_ptr<Step>> steps) noexcept;
+        std::vector<std::unique_ptr<Step>> steps,
+        TourLayout layout = TourLayout::ARRAY) noexcept;
 
     /**
      * Run the VND algorithm on the given problem.
@@ -41,5 +43,6 @@ private:
 
     std::unique_ptr<Construction> construction_;
     std::vector<std::unique_ptr<Step>> steps_;
+    TourLayout layout_;
 
 };